@@ -0,0 +1,56 @@
+#ifndef __DECIMATOR_H__
+#define __DECIMATOR_H__
+
+#include <stdint.h>
+
+// 3軸の2次CICフィルタによる間引き
+// 毎周期push()で積分し, rate周期に1回pop()で差分をとって1/rate^2倍する
+// 間引いた1サンプルは直前2*rate周期の三角窓の平均になり, 間引きで折り返す周波数を抑える
+// 積分は64bitの整数なので, 浮動小数点の値は固定小数点にしてから入れる
+// 1サンプルあたり加算6回(push)で, 間引く周期のpop()だけ除算する
+class DECIMATOR {
+private:
+	int64_t integ1[3];
+	int64_t integ2[3];
+	int64_t comb1[3];
+	int64_t comb2[3];
+	float scale;
+
+public:
+	DECIMATOR() {
+		reset(1);
+	}
+	// 間引き(rate周期に1回)を設定して状態を0に戻す
+	void reset(int rate) {
+		for (int i = 0; i < 3; i++) {
+			integ1[i] = 0;
+			integ2[i] = 0;
+			comb1[i] = 0;
+			comb2[i] = 0;
+		}
+		if (rate < 1) {
+			rate = 1;
+		}
+		scale = 1.0f / ((float)rate * rate);
+	}
+	inline void push(int32_t x, int32_t y, int32_t z) {
+		integ1[0] += x;
+		integ1[1] += y;
+		integ1[2] += z;
+		integ2[0] += integ1[0];
+		integ2[1] += integ1[1];
+		integ2[2] += integ1[2];
+	}
+	// 間引いた値(pushした値と同じ単位)
+	inline void pop(float out[3]) {
+		for (int i = 0; i < 3; i++) {
+			int64_t d1 = integ2[i] - comb1[i];
+			comb1[i] = integ2[i];
+			int64_t d2 = d1 - comb2[i];
+			comb2[i] = d1;
+			out[i] = d2 * scale;
+		}
+	}
+};
+
+#endif /* __DECIMATOR_H__ */
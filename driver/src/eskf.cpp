@@ -0,0 +1,159 @@
+#include <math.h>
+#include "fusion.h"
+
+ESKF::ESKF() {
+	noise_g = 0.01f;
+	noise_b = 0.0001f;
+	noise_a = 0.05f;
+	noise_m = 0.1f;
+	for (int i = 0; i < 6; i++) {
+		for (int j = 0; j < 6; j++) {
+			p[i][j] = 0;
+		}
+	}
+	for (int i = 0; i < 3; i++) {
+		p[i][i] = 0.1f;
+		p[i + 3][i + 3] = 0.0001f;
+		bias[i] = 0;
+	}
+}
+
+void ESKF::correct(const float h[6], float y, float r, float x[6]) {
+	// PH^T, S = HPH^T + r
+	float ph[6];
+	float s = r;
+	for (int i = 0; i < 6; i++) {
+		ph[i] = 0;
+		for (int j = 0; j < 6; j++) {
+			ph[i] += p[i][j] * h[j];
+		}
+	}
+	for (int i = 0; i < 6; i++) {
+		s += h[i] * ph[i];
+		y -= h[i] * x[i];
+	}
+	if (s <= 0) {
+		return;
+	}
+	// K = PH^T/S, x += Ky, P -= K(PH^T)^T
+	float rs = 1.0f / s;
+	for (int i = 0; i < 6; i++) {
+		float k = ph[i] * rs;
+		x[i] += k * y;
+		for (int j = 0; j < 6; j++) {
+			p[i][j] -= k * ph[j];
+		}
+	}
+}
+
+void ESKF::update(float q[4],
+	float wx, float wy, float wz,
+	float ax, float ay, float az,
+	float mx, float my, float mz,
+	float ka, float km,
+	float dt
+) {
+	// バイアスを除いた角速度で姿勢を積算
+	wx -= bias[0];
+	wy -= bias[1];
+	wz -= bias[2];
+	quat_integrate(q, wx, wy, wz, nullptr, dt);
+
+	// 誤差共分散の予測 P = FPF^T + Q
+	// F = | I + [ω]×dt  I dt |
+	//     |     0        I   |
+	float f[6][6];
+	for (int i = 0; i < 6; i++) {
+		for (int j = 0; j < 6; j++) {
+			f[i][j] = i == j ? 1.0f : 0.0f;
+		}
+	}
+	f[0][1] = -wz * dt, f[0][2] =  wy * dt;
+	f[1][0] =  wz * dt, f[1][2] = -wx * dt;
+	f[2][0] = -wy * dt, f[2][1] =  wx * dt;
+	f[0][3] = dt, f[1][4] = dt, f[2][5] = dt;
+	float fp[6][6];
+	for (int i = 0; i < 6; i++) {
+		for (int j = 0; j < 6; j++) {
+			float sum = 0;
+			for (int k = 0; k < 6; k++) {
+				sum += f[i][k] * p[k][j];
+			}
+			fp[i][j] = sum;
+		}
+	}
+	for (int i = 0; i < 6; i++) {
+		for (int j = 0; j < 6; j++) {
+			float sum = 0;
+			for (int k = 0; k < 6; k++) {
+				sum += fp[i][k] * f[j][k];
+			}
+			p[i][j] = sum;
+		}
+	}
+	for (int i = 0; i < 3; i++) {
+		p[i][i] += noise_g * noise_g * dt;
+		p[i + 3][i + 3] += noise_b * noise_b * dt;
+	}
+
+	const float qw = q[0], qx = q[1], qy = q[2], qz = q[3];
+	// Z軸基準ベクトル(推定した鉛直方向)
+	float zx, zy, zz;
+	zx = 2*(qx*qz - qw*qy);
+	zy = 2*(qy*qz + qw*qx);
+	zz = 2*(qw*qw + qz*qz) - 1;
+
+	float x[6] = { 0, 0, 0, 0, 0, 0 };
+	bool corrected = false;
+	if (!(0 == ax && 0 == ay && 0 == az) && ka > 0) {
+		// 鉛直方向の観測 a = z + [z]×δθ
+		// 重みが小さいほど観測ノイズを大きく見積もる
+		const float r = noise_a * noise_a / (ka * ka);
+		const float hx[6] = {   0, -zz,  zy, 0, 0, 0 };
+		const float hy[6] = {  zz,   0, -zx, 0, 0, 0 };
+		const float hz[6] = { -zy,  zx,   0, 0, 0, 0 };
+		correct(hx, ax - zx, r, x);
+		correct(hy, ay - zy, r, x);
+		correct(hz, az - zz, r, x);
+		corrected = true;
+	}
+	if (!(0 == mx && 0 == my && 0 == mz) && km > 0) {
+		// 姿勢方位(h)の方位角ψ = atan2(hy, hx)が0になるよう観測する
+		float xx, xy, xz, yx, yy, yz;
+		xx = 2*(qw*qw + qx*qx) - 1;
+		xy = 2*(qx*qy - qw*qz);
+		xz = 2*(qx*qz + qw*qy);
+		yx = 2*(qx*qy + qw*qz);
+		yy = 2*(qw*qw + qy*qy) - 1;
+		yz = 2*(qy*qz - qw*qx);
+		float hx = xx*mx + xy*my + xz*mz;
+		float hy = yx*mx + yy*my + yz*mz;
+		float hxy2 = hx*hx + hy*hy;
+		if (hxy2 > 0) {
+			// ∂h/∂δθ の各行は m × (回転行列の行)
+			float dx[3] = { my*xz - mz*xy, mz*xx - mx*xz, mx*xy - my*xx };
+			float dy[3] = { my*yz - mz*yy, mz*yx - mx*yz, mx*yy - my*yx };
+			float h[6] = { 0, 0, 0, 0, 0, 0 };
+			for (int i = 0; i < 3; i++) {
+				h[i] = (hx*dy[i] - hy*dx[i]) / hxy2;
+			}
+			correct(h, -atan2f(hy, hx), noise_m * noise_m / (km * km), x);
+			corrected = true;
+		}
+	}
+	if (!corrected) {
+		return;
+	}
+	// 誤差を姿勢とバイアスに反映 q = q⊗δq
+	const float dqe[4] = { 1, 0.5f*x[0], 0.5f*x[1], 0.5f*x[2] };
+	float qn[4];
+	quat_mul(q, dqe, qn);
+	float r = 1.0f / sqrtf(qn[0]*qn[0] + qn[1]*qn[1] + qn[2]*qn[2] + qn[3]*qn[3]);
+	q[0] = qn[0] * r;
+	q[1] = qn[1] * r;
+	q[2] = qn[2] * r;
+	q[3] = qn[3] * r;
+	bias[0] += x[3];
+	bias[1] += x[4];
+	bias[2] += x[5];
+}
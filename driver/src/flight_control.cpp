@@ -0,0 +1,119 @@
+#include <math.h>
+#include "imu_filter.h"
+#include "flight_control.h"
+
+// ミキサ(ロール, ピッチ, ヨー)の係数
+// 機体のモーター配置と回転方向に合わせて符号を変える
+static const float MIXER[MOTOR_COUNT][3] = {
+	{  1,  1, -1 }, // 左前
+	{ -1,  1,  1 }, // 右前
+	{ -1, -1, -1 }, // 右後
+	{  1, -1,  1 }, // 左後
+};
+
+float PID::update(float error, float dt) {
+	integral += error * dt;
+	if (integral > integral_limit) {
+		integral = integral_limit;
+	} else if (integral < -integral_limit) {
+		integral = -integral_limit;
+	}
+	// 最初の1回は前回の偏差が無いので微分を0にする
+	if (!primed) {
+		prev_error = error;
+		primed = true;
+	}
+	float derivative = (error - prev_error) / dt;
+	prev_error = error;
+	return kp*error + ki*integral + kd*derivative;
+}
+
+FLIGHT_CONTROL::FLIGHT_CONTROL() {
+	angle_gain = 4.0f;
+	max_angle = 0.5f;
+	max_rate = 4.0f;
+	setpoint_roll = 0;
+	setpoint_pitch = 0;
+	setpoint_yaw_rate = 0;
+	throttle = 0;
+	set_setpoint(0, 0);
+	set_rate_gain(0.05f, 0.02f, 0.001f);
+	rate_roll.integral_limit = 0.2f;
+	rate_pitch.integral_limit = 0.2f;
+	rate_yaw.integral_limit = 0.2f;
+	reset();
+}
+
+void FLIGHT_CONTROL::reset() {
+	rate_roll.reset();
+	rate_pitch.reset();
+	rate_yaw.reset();
+	for (int i = 0; i < MOTOR_COUNT; i++) {
+		motor[i] = 0;
+	}
+}
+
+void FLIGHT_CONTROL::set_setpoint(float x, float y) {
+	setpoint_roll = x * max_angle;
+	setpoint_pitch = y * max_angle;
+	// IMU_FILTER::compute_anglesのroll, pitchと同じ向きになるよう
+	// ピッチ(Y軸回り)⊗ロール(X軸回り)で傾きを作る
+	float cr = cosf(-0.5f * setpoint_roll);
+	float sr = sinf(-0.5f * setpoint_roll);
+	float cp = cosf(0.5f * setpoint_pitch);
+	float sp = sinf(0.5f * setpoint_pitch);
+	setpoint_tilt[0] = cp*cr;
+	setpoint_tilt[1] = cp*sr;
+	setpoint_tilt[2] = sp*cr;
+	setpoint_tilt[3] = -sp*sr;
+}
+
+void FLIGHT_CONTROL::compute_target(const float heading[4], float t[4]) const {
+	quat_mul(heading, setpoint_tilt, t);
+}
+
+void FLIGHT_CONTROL::set_rate_gain(float kp, float ki, float kd) {
+	rate_roll.kp = kp;
+	rate_roll.ki = ki;
+	rate_roll.kd = kd;
+	rate_pitch.kp = kp;
+	rate_pitch.ki = ki;
+	rate_pitch.kd = kd;
+	rate_yaw.kp = kp;
+	rate_yaw.ki = ki;
+	rate_yaw.kd = 0;
+}
+
+void FLIGHT_CONTROL::update(const float error[4], float wx, float wy, float wz, float dt) {
+	// スロットルが0なら停止して積分をリセット
+	if (throttle <= 0) {
+		reset();
+		return;
+	}
+	// 外側: 誤差クォータニオンから目標角速度を求める
+	// IMU_FILTERはq' = -q⊗ω/2で積算するので, 誤差を打ち消す角速度は-2e
+	float rate_x = -2 * angle_gain * error[1];
+	float rate_y = -2 * angle_gain * error[2];
+	float rate_z = setpoint_yaw_rate;
+	if (rate_x > max_rate) rate_x = max_rate;
+	if (rate_x < -max_rate) rate_x = -max_rate;
+	if (rate_y > max_rate) rate_y = max_rate;
+	if (rate_y < -max_rate) rate_y = -max_rate;
+	// 内側: 角速度の偏差から操作量を求める
+	float u_roll = rate_roll.update(rate_x - wx, dt);
+	float u_pitch = rate_pitch.update(rate_y - wy, dt);
+	float u_yaw = rate_yaw.update(rate_z - wz, dt);
+	// ミキサ
+	for (int i = 0; i < MOTOR_COUNT; i++) {
+		float m = throttle
+			+ MIXER[i][0]*u_roll
+			+ MIXER[i][1]*u_pitch
+			+ MIXER[i][2]*u_yaw;
+		if (m < 0) {
+			m = 0;
+		} else if (m > 1) {
+			m = 1;
+		}
+		motor[i] = m;
+	}
+}
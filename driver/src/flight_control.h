@@ -0,0 +1,64 @@
+#ifndef __FLIGHT_CONTROL_H__
+#define __FLIGHT_CONTROL_H__
+
+#define MOTOR_COUNT 4
+
+// PID制御器
+struct PID {
+	float kp;
+	float ki;
+	float kd;
+	float integral;
+	float integral_limit;
+	float prev_error;
+	// prev_errorが有効か(リセット直後の微分の跳ねを防ぐ)
+	bool primed;
+
+	void reset() {
+		integral = 0;
+		prev_error = 0;
+		primed = false;
+	}
+	float update(float error, float dt);
+};
+
+// 姿勢制御(外側: 角度→角速度目標, 内側: 角速度PID)とミキサ
+class FLIGHT_CONTROL {
+private:
+	PID rate_roll;
+	PID rate_pitch;
+	PID rate_yaw;
+	float angle_gain;
+	float max_angle;
+	float max_rate;
+
+public:
+	float setpoint_roll;
+	float setpoint_pitch;
+	float setpoint_yaw_rate;
+	// 目標姿勢の傾き成分(クォータニオン)
+	float setpoint_tilt[4];
+	float throttle;
+	// 各モーターの出力(0～1)
+	// 0:左前, 1:右前, 2:右後, 3:左後
+	float motor[MOTOR_COUNT];
+
+public:
+	FLIGHT_CONTROL();
+	void reset();
+	// 現在のヨー成分(IMU_FILTER::get_heading)に目標の傾きを合成して目標姿勢を求める
+	void compute_target(const float heading[4], float t[4]) const;
+	// 誤差クォータニオン(IMU_FILTER::compute_error)と角速度(rad/s)から各モーターの出力を求める
+	void update(const float error[4], float wx, float wy, float wz, float dt);
+	// pコマンドの値(-1～1)から目標角度を設定する
+	void set_setpoint(float x, float y);
+	void set_throttle(float throttle) {
+		this->throttle = throttle;
+	}
+	void set_angle_gain(float angle_gain) {
+		this->angle_gain = angle_gain;
+	}
+	void set_rate_gain(float kp, float ki, float kd);
+};
+
+#endif /* __FLIGHT_CONTROL_H__ */
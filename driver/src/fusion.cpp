@@ -0,0 +1,29 @@
+#include <math.h>
+#include "fusion.h"
+
+void quat_integrate(float q[4], float wx, float wy, float wz, const float s[4], float dt) {
+	float dq[4];
+	quat_derivative(q, wx, wy, wz, dq);
+	if (s != nullptr) {
+		dq[0] += s[0], dq[1] += s[1], dq[2] += s[2], dq[3] += s[3];
+	}
+#ifdef FUSION_RK2
+	// 中点の姿勢での変化量で積算する
+	float qm[4];
+	const float h = 0.5f * dt;
+	qm[0] = q[0] + dq[0] * h;
+	qm[1] = q[1] + dq[1] * h;
+	qm[2] = q[2] + dq[2] * h;
+	qm[3] = q[3] + dq[3] * h;
+	quat_derivative(qm, wx, wy, wz, dq);
+	if (s != nullptr) {
+		dq[0] += s[0], dq[1] += s[1], dq[2] += s[2], dq[3] += s[3];
+	}
+#endif
+	q[0] += dq[0] * dt;
+	q[1] += dq[1] * dt;
+	q[2] += dq[2] * dt;
+	q[3] += dq[3] * dt;
+	float r = 1.0f / sqrtf(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+	q[0] *= r, q[1] *= r, q[2] *= r, q[3] *= r;
+}
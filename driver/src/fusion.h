@@ -0,0 +1,110 @@
+#ifndef __FUSION_H__
+#define __FUSION_H__
+
+// 姿勢推定エンジン
+// IMU_FILTER_T<ENGINE>のテンプレート引数で選ぶ(仮想関数は使わない)
+// 各エンジンは次のメンバーを持つ
+//	void set_gain(float gain);
+//	void update(float q[4],
+//		float wx, float wy, float wz,  // 角速度(rad/s)
+//		float ax, float ay, float az,  // 正規化済みの加速度(0ベクトルなら補正しない)
+//		float mx, float my, float mz,  // 正規化済みの方位(0ベクトルなら補正しない)
+//		float ka, float km,            // 加速度と方位の補正の重み(1で通常, 0で補正しない)
+//		float dt);
+// 姿勢qは q' = -q⊗ω/2 で積算する(MADGWICKに合わせた向き)
+
+// クォータニオン(w, x, y, z)の積 r = a ⊗ b
+inline void quat_mul(const float a[4], const float b[4], float r[4]) {
+	r[0] = a[0]*b[0] - a[1]*b[1] - a[2]*b[2] - a[3]*b[3];
+	r[1] = a[0]*b[1] + a[1]*b[0] + a[2]*b[3] - a[3]*b[2];
+	r[2] = a[0]*b[2] - a[1]*b[3] + a[2]*b[0] + a[3]*b[1];
+	r[3] = a[0]*b[3] + a[1]*b[2] - a[2]*b[1] + a[3]*b[0];
+}
+
+// 角速度wでの姿勢の変化 dq = -q⊗ω/2
+inline void quat_derivative(const float q[4], float wx, float wy, float wz, float dq[4]) {
+	dq[0] = -0.5f*(      - wx*q[1] - wy*q[2] - wz*q[3]);
+	dq[1] = -0.5f*(wx*q[0]         + wz*q[2] - wy*q[3]);
+	dq[2] = -0.5f*(wy*q[0] - wz*q[1]         + wx*q[3]);
+	dq[3] = -0.5f*(wz*q[0] + wy*q[1] - wx*q[2]        );
+}
+
+// 角速度wと補正量s(姿勢の変化率に加える, nullptrなら補正なし)でdt秒積算して正規化
+// FUSION_RK2を定義すると2次のルンゲ・クッタ(中点法), しなければオイラー法
+void quat_integrate(float q[4], float wx, float wy, float wz, const float s[4], float dt);
+
+// Madgwickの勾配降下法
+class MADGWICK {
+private:
+	float beta;
+
+public:
+	MADGWICK() : beta(1.0f) { }
+	void set_gain(float gain) {
+		beta = gain;
+	}
+	void update(float q[4],
+		float wx, float wy, float wz,
+		float ax, float ay, float az,
+		float mx, float my, float mz,
+		float ka, float km,
+		float dt);
+};
+
+// MahonyのPI補正(相補フィルタ)
+class MAHONY {
+private:
+	float kp;
+	float ki;
+	float ix, iy, iz;
+
+public:
+	MAHONY() : kp(1.0f), ki(0.1f), ix(0), iy(0), iz(0) { }
+	// 比例ゲインを設定(積分ゲインは1/10)
+	void set_gain(float gain) {
+		kp = gain;
+		ki = gain * 0.1f;
+	}
+	void update(float q[4],
+		float wx, float wy, float wz,
+		float ax, float ay, float az,
+		float mx, float my, float mz,
+		float ka, float km,
+		float dt);
+};
+
+// ジャイロバイアスを推定するエラー状態カルマンフィルタ
+// 誤差状態はボディ座標の姿勢誤差(3)とジャイロバイアス(3)
+class ESKF {
+private:
+	float p[6][6];
+	float bias[3];
+	float noise_g;
+	float noise_b;
+	float noise_a;
+	float noise_m;
+
+public:
+	ESKF();
+	// 加速度の観測ノイズ(標準偏差)を設定
+	void set_gain(float gain) {
+		noise_a = gain;
+	}
+	void get_bias(float b[3]) const {
+		b[0] = bias[0];
+		b[1] = bias[1];
+		b[2] = bias[2];
+	}
+	void update(float q[4],
+		float wx, float wy, float wz,
+		float ax, float ay, float az,
+		float mx, float my, float mz,
+		float ka, float km,
+		float dt);
+
+private:
+	// 観測行列h(1x6)の1次元の観測で誤差状態xを更新
+	void correct(const float h[6], float y, float r, float x[6]);
+};
+
+#endif /* __FUSION_H__ */
@@ -1,16 +1,14 @@
 #ifndef __IMU_FILTER_H__
 #define __IMU_FILTER_H__
 
-class IMU_FILTER {
-private:
-	float delta_time;
-	float beta;
-	float gscale;
-	float mscale;
-	float qw;
-	float qx;
-	float qy;
-	float qz;
+#include <math.h>
+#include "fusion.h"
+
+// 姿勢(クォータニオン)と参照用の変換
+class IMU_ATTITUDE {
+protected:
+	// 姿勢のクォータニオン(w, x, y, z)
+	float q[4];
 
 public:
 	float roll;
@@ -18,21 +16,239 @@ public:
 	float yaw;
 
 public:
-	IMU_FILTER();
-	void update(float wx, float wy, float wz, float ax, float ay, float az, float mx, float my, float mz);
+	IMU_ATTITUDE();
+	// roll, pitch, yawを求める(表示用, 逆三角関数を使う)
 	void compute_angles();
+	// 姿勢のクォータニオン(w, x, y, z)
+	void get_quaternion(float q[4]) const {
+		q[0] = this->q[0];
+		q[1] = this->q[1];
+		q[2] = this->q[2];
+		q[3] = this->q[3];
+	}
+	// 姿勢の回転行列(行優先3x3)
+	void get_rotation(float m[9]) const;
+	// 姿勢のヨー成分だけのクォータニオン
+	void get_heading(float q[4]) const;
+	// 現在の姿勢から目標姿勢tへの誤差クォータニオン(e = q^-1 ⊗ t, e[0] >= 0)
+	void compute_error(const float t[4], float e[4]) const;
+};
+
+// 適応ゲインで重みを0にする大きさのずれ(基準に対する比)
+#define IMU_ADAPT_ACCEL_BAND 0.25f
+#define IMU_ADAPT_MAG_BAND   0.3f
+// 方位の大きさの基準を追従させる時定数(s)
+#define IMU_ADAPT_MAG_TAU    10.0f
+// 経過時間の上限(サンプリング周期の倍数)
+#define IMU_DT_MAX           4.0f
+
+// 姿勢推定フィルタ
+// ENGINEはfusion.hのMADGWICK, MAHONY, ESKFのいずれか
+template <class ENGINE>
+class IMU_FILTER_T : public IMU_ATTITUDE {
+private:
+	float delta_time;
+	float gscale;
+	// 角速度の生の値から(rad/s)への変換
+	// 分解能(gres)と軸ごとの係数をまとめたgyro_kを, ゼロ点を引いた値に掛ける
+	// gscaleは姿勢推定に渡す角速度だけに掛ける(get_rate, calibrate_rateには掛けない)
+	float gres;
+	float gyro_gain[3];
+	float gyro_offset[3];
+	float gyro_k[3];
+	// 前回の角速度(rad/s)
+	float rate[3];
+	float mscale;
+	// 加速度の分解能(g/LSB, 0なら大きさで重みを付けない)
+	float ascale;
+	// 適応ゲイン
+	bool adaptive;
+	float boost;       // 起動直後に上乗せする補正の倍率(減衰する)
+	float boost_tau;   // 上乗せの減衰時定数(s)
+	float mag_ref;     // 方位の大きさの基準(生値の移動平均)
+	// タイムスタンプ
+	bool time_valid;
+	unsigned long time_prev;  // 前回のタイムスタンプ(us)
+	float dt_last;            // 前回積算に使った経過時間(s)
+	unsigned long dt_anomaly; // 経過時間が異常だった回数
+
+public:
+	ENGINE engine;
+
+public:
+	IMU_FILTER_T() {
+		delta_time = 1.0f / 100.0f;
+		gscale = 1.0f;
+		gres = 1.0f;
+		for (int i = 0; i < 3; i++) {
+			gyro_gain[i] = 1.0f;
+			gyro_offset[i] = 0;
+			rate[i] = 0;
+		}
+		compute_gyro_k();
+		mscale = 1.0f;
+		ascale = 0;
+		adaptive = false;
+		boost = 0;
+		boost_tau = 1.0f;
+		mag_ref = 0;
+		time_valid = false;
+		time_prev = 0;
+		dt_last = delta_time;
+		dt_anomaly = 0;
+	}
+	void update(float wx, float wy, float wz, float ax, float ay, float az, float mx, float my, float mz) {
+		update(wx, wy, wz, ax, ay, az, mx, my, mz, delta_time);
+	}
+	// サンプルのタイムスタンプ(us)を指定して更新する
+	void update_micros(float wx, float wy, float wz, float ax, float ay, float az, float mx, float my, float mz, unsigned long time) {
+		float dt = delta_time;
+		if (time_valid) {
+			dt = (time - time_prev) * 1e-6f;
+		}
+		time_prev = time;
+		time_valid = true;
+		update(wx, wy, wz, ax, ay, az, mx, my, mz, dt);
+	}
+	// 前回からの経過時間dt(s)を指定して更新する
+	// 加速度や方位が0ベクトルなら新しいデータがないとみなして補正しない
+	void update(float wx, float wy, float wz, float ax, float ay, float az, float mx, float my, float mz, float dt) {
+		// 経過時間が0以下やサンプリング周期のIMU_DT_MAX倍を超えるときは制限する
+		if (!(dt > 0)) {
+			dt = delta_time;
+			dt_anomaly++;
+		} else if (dt > IMU_DT_MAX * delta_time) {
+			dt = IMU_DT_MAX * delta_time;
+			dt_anomaly++;
+		}
+		dt_last = dt;
+		// 角速度の生の値を校正して(rad/s)に変換
+		wx = (wx - gyro_offset[0]) * gyro_k[0];
+		wy = (wy - gyro_offset[1]) * gyro_k[1];
+		wz = (wz - gyro_offset[2]) * gyro_k[2];
+		rate[0] = wx, rate[1] = wy, rate[2] = wz;
+		wx *= gscale, wy *= gscale, wz *= gscale;
+		// 補正の重み
+		float ka = 1.0f, km = 1.0f;
+		if (adaptive) {
+			// 起動直後は補正を強くして早く収束させる
+			ka += boost;
+			km += boost;
+			boost -= boost * dt / boost_tau;
+		}
+		if (!(0 == ax && 0 == ay && 0 == az)) {
+			// 加速度を正規化
+			float n = sqrtf(ax*ax + ay*ay + az*az);
+			if (adaptive && ascale > 0) {
+				// 1gから外れるほど運動加速度が大きいので重みを下げる
+				ka *= adapt_weight(n * ascale, IMU_ADAPT_ACCEL_BAND);
+			}
+			float r = 1.0f / n;
+			ax *= r, ay *= r, az *= r;
+		}
+		if (!(0 == mx && 0 == my && 0 == mz)) {
+			// 方位を正規化
+			float n = sqrtf(mx*mx + my*my + mz*mz);
+			if (adaptive) {
+				// 大きさが基準から外れるときは磁気の乱れとみなして重みを下げる
+				if (mag_ref > 0) {
+					km *= adapt_weight(n / mag_ref, IMU_ADAPT_MAG_BAND);
+					mag_ref += (n - mag_ref) * dt / IMU_ADAPT_MAG_TAU;
+				} else {
+					mag_ref = n;
+				}
+			}
+			float r = mscale / n;
+			mx *= r, my *= r, mz *= r;
+		}
+		engine.update(q, wx, wy, wz, ax, ay, az, mx, my, mz, ka, km, dt);
+	}
+	// 適応ゲインを有効にする
+	// 補正をgain倍から始めて時定数tau(s)で1倍まで減衰させる(gain <= 0なら無効)
+	void set_adaptive(float gain, float tau) {
+		adaptive = gain > 0;
+		boost = gain > 1 ? gain - 1 : 0;
+		boost_tau = tau > 0 ? tau : 1.0f;
+		mag_ref = 0;
+	}
+	// 加速度の分解能(g/LSB)
+	void set_ascale(float ascale) {
+		this->ascale = ascale;
+	}
+	// タイムスタンプを破棄する(次のupdate_microsはサンプリング周期で積算する)
+	void reset_time() {
+		time_valid = false;
+	}
+	// 前回積算に使った経過時間(s)
+	float get_dt() const {
+		return dt_last;
+	}
+	// 経過時間が異常で制限した回数
+	unsigned long get_dt_anomaly() const {
+		return dt_anomaly;
+	}
+	// 公称のサンプリング周波数(経過時間を指定しないときと, 経過時間の制限に使う)
 	void set_sample_rate(float sample_rate) {
 		delta_time = 1.0f / sample_rate;
 	}
-	void set_beta(float beta) {
-		this->beta = beta;
+	void set_gain(float gain) {
+		engine.set_gain(gain);
+	}
+	// 角速度の分解能((rad/s)/LSB, 1なら(rad/s)の値を入れる)
+	void set_gres(float gres) {
+		this->gres = gres;
+		compute_gyro_k();
 	}
+	// 姿勢推定に渡す角速度の倍率(調整用, 制御とテレメトリには影響しない)
 	void set_gscale(float gscale) {
 		this->gscale = gscale;
 	}
+	// 軸ごとの角速度のゼロ点(生の値)
+	void set_gyro_offset(const float offset[3]) {
+		for (int i = 0; i < 3; i++) {
+			gyro_offset[i] = offset[i];
+		}
+	}
+	// 軸ごとの角速度の倍率
+	void set_gyro_gain(const float gain[3]) {
+		for (int i = 0; i < 3; i++) {
+			gyro_gain[i] = gain[i];
+		}
+		compute_gyro_k();
+	}
+	// 前回の更新で使った校正済みの角速度(rad/s)
+	void get_rate(float w[3]) const {
+		w[0] = rate[0];
+		w[1] = rate[1];
+		w[2] = rate[2];
+	}
+	// 角速度の生の値(間引いた平均など)を校正して(rad/s)にする
+	void calibrate_rate(const float raw[3], float w[3]) const {
+		for (int i = 0; i < 3; i++) {
+			w[i] = (raw[i] - gyro_offset[i]) * gyro_k[i];
+		}
+	}
 	void set_mscale(float mscale) {
 		this->mscale = mscale;
 	}
+
+private:
+	void compute_gyro_k() {
+		for (int i = 0; i < 3; i++) {
+			gyro_k[i] = gres * gyro_gain[i];
+		}
+	}
+	// 大きさの比nが1からband以上ずれると0になる重み
+	static float adapt_weight(float n, float band) {
+		float w = 1.0f - fabsf(n - 1.0f) / band;
+		return w > 0 ? w : 0;
+	}
 };
 
+// 使用するエンジン(MADGWICK, MAHONY, ESKF)
+#ifndef IMU_FUSION_ENGINE
+#define IMU_FUSION_ENGINE MADGWICK
+#endif
+typedef IMU_FILTER_T<IMU_FUSION_ENGINE> IMU_FILTER;
+
 #endif /* __IMU_FILTER_H__ */
@@ -0,0 +1,85 @@
+#include <Arduino.h>
+#include "imu_reader.h"
+
+// 読込みタスクの優先度
+// 同じコアのWiFi(23)やlwIP(18)より低くして通信を止めないようにする(スペクトル解析(1)よりは高い)
+#define IMU_READER_PRIORITY  5
+// センサーの応答をLSM9DS1::check()で確かめる間隔(読込み回数, 600Hzで約1.7秒)
+// SPIは転送の失敗が分からないので, センサーが外れたりリセットされたことはこれで見つける
+#define IMU_READER_CHECK_INTERVAL 1024
+
+IMU_READER::IMU_READER() {
+	imu = nullptr;
+	task = nullptr;
+	owner = nullptr;
+	busy = false;
+	temperature_request = false;
+	check_count = 0;
+}
+
+bool IMU_READER::begin(LSM9DS1 &imu, int core) {
+	this->imu = &imu;
+	owner = xTaskGetCurrentTaskHandle();
+	return pdPASS == xTaskCreatePinnedToCore(task_entry, "imu_reader", 4096, this, IMU_READER_PRIORITY, &task, core);
+}
+
+void IMU_READER::start() {
+	if (busy) {
+		return;
+	}
+	busy = true;
+	xTaskNotifyGive(task);
+}
+
+bool IMU_READER::collect(IMU_SAMPLE &s, unsigned long timeout) {
+	if (!busy) {
+		return false;
+	}
+	// N tickの待ちは(N - 1)からN tickなので1tick足す
+	if (0 == ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS((timeout + 999) / 1000) + 1)) {
+		return false;
+	}
+	s = sample;
+	busy = false;
+	return true;
+}
+
+void IMU_READER::task_entry(void *arg) {
+	auto self = (IMU_READER*)arg;
+	while (1) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		self->read();
+		xTaskNotifyGive(self->owner);
+	}
+}
+
+void IMU_READER::read() {
+	// ジャイロと加速度(952Hz), 方位(80Hz)は出力レートが違うので
+	// 新しいデータがあるものだけ読み込む
+	unsigned long begin = micros();
+	// 新しいデータが無ければ1tick休んで, 待つ間はコアを他のタスクに譲る
+	// (ODRはサンプリング周波数より高いので, 普通は最初の確認で読める)
+	uint8_t status = imu->available_ag();
+	while (!(status & LSM9DS1_AVAILABLE_G) && micros() - begin < IMU_READER_POLL_TIME) {
+		vTaskDelay(1);
+		status = imu->available_ag();
+	}
+	sample.time = micros();
+	sample.valid_g = (status & LSM9DS1_AVAILABLE_G) && imu->read_g();
+	sample.valid_a = (status & LSM9DS1_AVAILABLE_A) && imu->read_a();
+	sample.valid_m = imu->available_m() && imu->read_m();
+	sample.valid_t = false;
+	if (temperature_request) {
+		temperature_request = false;
+		sample.valid_t = imu->read_t();
+	}
+	sample.gx = imu->gx, sample.gy = imu->gy, sample.gz = imu->gz;
+	sample.ax = imu->ax, sample.ay = imu->ay, sample.az = imu->az;
+	sample.mx = imu->mx, sample.my = imu->my, sample.mz = imu->mz;
+	sample.temperature = imu->temperature;
+	// 応答しなければcheck()の中で回復する(次の読込みから値が戻る)
+	if (++check_count >= IMU_READER_CHECK_INTERVAL) {
+		check_count = 0;
+		imu->check();
+	}
+}
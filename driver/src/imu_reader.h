@@ -0,0 +1,63 @@
+#ifndef __IMU_READER_H__
+#define __IMU_READER_H__
+
+#include <Arduino.h>
+#include "lsm9ds1.h"
+
+// ジャイロの新しいデータを待つ最大時間(us, ODR 952Hzの約2周期)
+#define IMU_READER_POLL_TIME 2000
+// 新しいデータが揃ってからの転送の最長時間(us, I2C 400kHzで温度とcheck()も読む場合)
+#define IMU_READER_READ_TIME 1500
+// 読込みの最長時間(us, collect()のtimeout)
+// 待つ時間の最後のvTaskDelay(1)は1tick延びることがある
+#define IMU_READER_TIMEOUT   (IMU_READER_POLL_TIME + portTICK_PERIOD_MS * 1000 + IMU_READER_READ_TIME)
+
+// 1回分のセンサーデータ
+struct IMU_SAMPLE {
+	unsigned long time;  // ジャイロを読み込んだ時刻(us)
+	int16_t gx, gy, gz;  // 生の値(単位の変換と校正はIMU_FILTERで行う)
+	int16_t ax, ay, az;
+	int16_t mx, my, mz;
+	int16_t temperature; // 温度(℃, 最後に読み込んだ値)
+	bool valid_g;        // ジャイロを読み込めた
+	bool valid_a;        // 新しい加速度を読み込めた
+	bool valid_m;        // 新しい方位を読み込めた
+	bool valid_t;        // 温度を読み込めた
+};
+
+// センサーの非同期読込み
+// 読込み用のタスクを別のコアで動かし, start()で読込みを始めて
+// その間に前回のデータで姿勢推定を行い, collect()で読み込んだデータを受け取る
+// 開始後はLSM9DS1に触るのはこのタスクだけにすること
+class IMU_READER {
+private:
+	LSM9DS1 *imu;
+	TaskHandle_t task;
+	TaskHandle_t owner;
+	IMU_SAMPLE sample;
+	volatile bool busy;
+	volatile bool temperature_request;
+	// check()までの読込み回数
+	uint16_t check_count;
+
+public:
+	IMU_READER();
+	// 読込み用のタスクをcoreで開始する
+	bool begin(LSM9DS1 &imu, int core);
+	// 読込みを開始する(読込み中なら何もしない)
+	void start();
+	// 読込みの完了を少なくともtimeout(us)待って受け取る
+	// 新しいデータを待つ読込みはIMU_READER_TIMEOUTまでかかることがある
+	// 完了しなかったり開始していなければfalseを返す(読込みは続き, 次のcollect()で受け取る)
+	bool collect(IMU_SAMPLE &s, unsigned long timeout);
+	// 次の読込みで温度も読み込む(温度は変化が遅いので必要なときだけ読む)
+	void request_t() {
+		temperature_request = true;
+	}
+
+private:
+	static void task_entry(void *arg);
+	void read();
+};
+
+#endif /* __IMU_READER_H__ */
@@ -0,0 +1,96 @@
+#include <Arduino.h>
+#include "instrument.h"
+
+#ifdef INSTRUMENT_ENABLE
+
+INSTRUMENT instrument;
+
+void INSTRUMENT::reset() {
+	for (int i = 0; i < INSTRUMENT_STAGE_COUNT; i++) {
+		count[i] = 0;
+		cycles[i] = 0;
+		cycles_max[i] = 0;
+	}
+	for (int i = 0; i < INSTRUMENT_PERIOD_BINS; i++) {
+		period[i] = 0;
+	}
+	for (int i = 0; i < INSTRUMENT_JITTER_BINS; i++) {
+		jitter[i] = 0;
+	}
+	tick_prev = 0;
+	ticks = 0;
+	missed = 0;
+	i2c_error = 0;
+	tx_bytes = 0;
+	tx_short = 0;
+	bus_count = 0;
+	bus_cycles = 0;
+}
+
+void INSTRUMENT::tick(uint32_t now, uint32_t nominal) {
+	if (tick_prev != 0) {
+		uint32_t p = now - tick_prev;
+		uint32_t bin = p / INSTRUMENT_PERIOD_STEP;
+		period[bin < INSTRUMENT_PERIOD_BINS ? bin : INSTRUMENT_PERIOD_BINS - 1]++;
+		uint32_t j = p > nominal ? p - nominal : nominal - p;
+		bin = 0;
+		while (j != 0 && bin < INSTRUMENT_JITTER_BINS - 1) {
+			j >>= 1;
+			bin++;
+		}
+		jitter[bin]++;
+	}
+	tick_prev = now;
+	ticks++;
+}
+
+void INSTRUMENT::stage(INSTRUMENT_STAGE s) {
+	uint32_t now = ESP.getCycleCount();
+	uint32_t c = now - mark;
+	count[s]++;
+	cycles[s] += c;
+	if (c > cycles_max[s]) {
+		cycles_max[s] = c;
+	}
+	mark = now;
+}
+
+int INSTRUMENT::format(char *buf, int size) const {
+	// #stats <処理ごとの 回数 平均 最大(cycle)> p <周期> j <揺らぎ> missed i2c tx short
+	//        bus <1周期あたり(us)> <1転送あたり(us)>
+	int n = snprintf(buf, size, "#stats");
+	for (int i = 0; i < INSTRUMENT_STAGE_COUNT && n < size; i++) {
+		n += snprintf(buf + n, size - n, " %u %u %u",
+			(unsigned)count[i],
+			(unsigned)(count[i] ? cycles[i] / count[i] : 0),
+			(unsigned)cycles_max[i]
+		);
+	}
+	if (n < size) {
+		n += snprintf(buf + n, size - n, " p");
+	}
+	for (int i = 0; i < INSTRUMENT_PERIOD_BINS && n < size; i++) {
+		n += snprintf(buf + n, size - n, " %u", (unsigned)period[i]);
+	}
+	if (n < size) {
+		n += snprintf(buf + n, size - n, " j");
+	}
+	for (int i = 0; i < INSTRUMENT_JITTER_BINS && n < size; i++) {
+		n += snprintf(buf + n, size - n, " %u", (unsigned)jitter[i]);
+	}
+	if (n < size) {
+		n += snprintf(buf + n, size - n, " %u %u %u %u",
+			(unsigned)missed, (unsigned)i2c_error, (unsigned)tx_bytes, (unsigned)tx_short
+		);
+	}
+	if (n < size) {
+		float us = (float)bus_cycles / ESP.getCpuFreqMHz();
+		n += snprintf(buf + n, size - n, " bus %.1f %.1f\n",
+			ticks ? us / ticks : 0.0f,
+			bus_count ? us / bus_count : 0.0f
+		);
+	}
+	return n < size ? n : size - 1;
+}
+
+#endif /* INSTRUMENT_ENABLE */
@@ -0,0 +1,88 @@
+#ifndef __INSTRUMENT_H__
+#define __INSTRUMENT_H__
+
+// ループの計測(INSTRUMENT_ENABLEを定義したときだけ有効)
+// 無効のときはマクロが空になり, 計測のコードもカウンタも残らない
+// platformio.iniのbuild_flagsに -DINSTRUMENT_ENABLE を加えて有効にする
+
+#include <stdint.h>
+
+// 計測する処理
+enum INSTRUMENT_STAGE {
+	INSTRUMENT_WAIT,      // 読込みの完了待ち(collect, 読込み自体は別のコアのタスクで行う)
+	INSTRUMENT_FILTER,    // 姿勢推定
+	INSTRUMENT_CONTROL,   // 姿勢制御
+	INSTRUMENT_ANALYSIS,  // スペクトル解析への受け渡し, ノッチの追従, 間引きのフィルタ
+	INSTRUMENT_TELEMETRY, // テレメトリ送信
+	INSTRUMENT_COMMAND,   // コマンド解析
+	INSTRUMENT_STAGE_COUNT
+};
+
+// ヒストグラムの区間数
+#define INSTRUMENT_PERIOD_BINS  16   // ループ周期(INSTRUMENT_PERIOD_STEP(us)ごと, 最後は超過分)
+#define INSTRUMENT_PERIOD_STEP  250
+#define INSTRUMENT_JITTER_BINS  12   // 周期の揺らぎ(us)の2進の桁数ごと(0, 1, 2～3, 4～7, ...)
+
+#ifdef INSTRUMENT_ENABLE
+
+struct INSTRUMENT {
+	// 処理ごとのCPUサイクル数
+	uint32_t count[INSTRUMENT_STAGE_COUNT];
+	uint32_t cycles[INSTRUMENT_STAGE_COUNT];
+	uint32_t cycles_max[INSTRUMENT_STAGE_COUNT];
+	// ループ周期と揺らぎのヒストグラム
+	uint32_t period[INSTRUMENT_PERIOD_BINS];
+	uint32_t jitter[INSTRUMENT_JITTER_BINS];
+	uint32_t tick_prev;
+	uint32_t ticks;
+	// 周期に間に合わなかった回数
+	uint32_t missed;
+	// I2Cの読込み失敗回数
+	uint32_t i2c_error;
+	// 送信したバイト数と書き込みきれなかった回数
+	uint32_t tx_bytes;
+	uint32_t tx_short;
+	// バス転送の回数とCPUサイクル数
+	uint32_t bus_count;
+	uint32_t bus_cycles;
+	// 計測開始のサイクル数
+	uint32_t mark;
+
+	void reset();
+	// 周期実行の時刻(us)とその周期(us)を記録する
+	void tick(uint32_t now, uint32_t nominal);
+	// 前回のmarkからの経過サイクル数をstageに加えてmarkし直す
+	void stage(INSTRUMENT_STAGE stage);
+	// バス転送1回分のサイクル数を加える
+	void bus(uint32_t cycles) {
+		bus_count++;
+		bus_cycles += cycles;
+	}
+	// スナップショットを1行の文字列にする(戻り値は書き込んだ文字数)
+	int format(char *buf, int size) const;
+};
+extern INSTRUMENT instrument;
+
+#define INSTRUMENT_MARK()          (instrument.mark = ESP.getCycleCount())
+#define INSTRUMENT_STAGE_END(s)    instrument.stage(s)
+#define INSTRUMENT_TICK(now, nom)  instrument.tick(now, nom)
+#define INSTRUMENT_MISSED()        (instrument.missed++)
+#define INSTRUMENT_I2C_ERROR()     (instrument.i2c_error++)
+#define INSTRUMENT_BUS_BEGIN()     uint32_t instrument_bus = ESP.getCycleCount()
+#define INSTRUMENT_BUS_END()       instrument.bus(ESP.getCycleCount() - instrument_bus)
+#define INSTRUMENT_TX(sent, len)   do { instrument.tx_bytes += (sent); if ((sent) < (len)) instrument.tx_short++; } while (0)
+
+#else
+
+#define INSTRUMENT_MARK()
+#define INSTRUMENT_STAGE_END(s)
+#define INSTRUMENT_TICK(now, nom)
+#define INSTRUMENT_MISSED()
+#define INSTRUMENT_I2C_ERROR()
+#define INSTRUMENT_BUS_BEGIN()
+#define INSTRUMENT_BUS_END()
+#define INSTRUMENT_TX(sent, len)   ((void)(sent), (void)(len))
+
+#endif /* INSTRUMENT_ENABLE */
+
+#endif /* __INSTRUMENT_H__ */
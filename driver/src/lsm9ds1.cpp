@@ -1,7 +1,10 @@
 #include <Wire.h>
+#include <SPI.h>
 
 #include "lsm9ds1.h"
 #include "lsm9ds1_defines.h"
+#include "lsm9ds1_config.h"
+#include "instrument.h"
 
 // Accel/Gyro Registers
 #define ACT_THS				0x04
@@ -101,20 +104,183 @@
 #define SENSITIVITY_MAGNETOMETER_12  0.00043
 #define SENSITIVITY_MAGNETOMETER_16  0.00058
 
-LSM9DS1::LSM9DS1() { }
+// Register images of a compile-time configuration (see lsm9ds1_config.h).
+// Every field is checked here, so an invalid configuration fails to compile.
+struct LSM9DS1_REGISTER {
+	uint8_t addr;
+	uint8_t value;
+};
+
+template<class C>
+struct LSM9DS1_IMAGE {
+	static_assert(C::gyro_scale == 245 || C::gyro_scale == 500 || C::gyro_scale == 2000,
+		"gyro_scale must be 245, 500 or 2000 dps");
+	static_assert(!C::gyro_enabled || (1 <= C::gyro_sample_rate && C::gyro_sample_rate <= 6),
+		"gyro_sample_rate must be 1-6");
+	static_assert(C::gyro_bandwidth <= 3, "gyro_bandwidth must be 0-3");
+	static_assert(C::gyro_hpf_cutoff <= 9, "gyro_hpf_cutoff must be 0-9");
+	static_assert(C::gyro_orientation <= 5, "gyro_orientation must be 0-5");
+	static_assert(!C::gyro_lowpower_enable || C::gyro_sample_rate <= 3,
+		"gyro low-power mode is only available up to 119 Hz (gyro_sample_rate 1-3)");
+	static_assert(C::accel_scale == 2 || C::accel_scale == 4 || C::accel_scale == 8 || C::accel_scale == 16,
+		"accel_scale must be 2, 4, 8 or 16 g");
+	static_assert(!C::accel_enabled || (1 <= C::accel_sample_rate && C::accel_sample_rate <= 6),
+		"accel_sample_rate must be 1-6");
+	static_assert(!C::gyro_enabled || !C::accel_enabled || C::accel_sample_rate == C::gyro_sample_rate,
+		"with the gyro on, the accel runs at the gyro rate (accel_sample_rate must match)");
+	static_assert(-1 <= C::accel_bandwidth && C::accel_bandwidth <= 3, "accel_bandwidth must be -1-3");
+	static_assert(C::accel_highres_bandwidth <= 3, "accel_highres_bandwidth must be 0-3");
+	static_assert(C::mag_scale == 4 || C::mag_scale == 8 || C::mag_scale == 12 || C::mag_scale == 16,
+		"mag_scale must be 4, 8, 12 or 16 gauss");
+	static_assert(C::mag_sample_rate <= 7, "mag_sample_rate must be 0-7");
+	static_assert(C::mag_xy_performance <= 3 && C::mag_z_performance <= 3, "mag performance must be 0-3");
+	static_assert(C::mag_operating_mode <= 2, "mag_operating_mode must be 0-2");
+
+	// CTRL_REG1_G: [ODR_G2][ODR_G1][ODR_G0][FS_G1][FS_G0][0][BW_G1][BW_G0]
+	static constexpr uint8_t ctrl_reg1_g =
+		(C::gyro_enabled ? (C::gyro_sample_rate & 0x07) << 5 : 0) |
+		(C::gyro_scale == 500 ? 0x1 << 3 : C::gyro_scale == 2000 ? 0x3 << 3 : 0) |
+		(C::gyro_bandwidth & 0x3);
+	// CTRL_REG3_G: [LP_mode][HP_EN][0][0][HPCF3_G][HPCF2_G][HPCF1_G][HPCF0_G]
+	static constexpr uint8_t ctrl_reg3_g =
+		(C::gyro_lowpower_enable ? 1<<7 : 0) |
+		(C::gyro_hpf_enable ? (1<<6) | (C::gyro_hpf_cutoff & 0x0F) : 0);
+	// CTRL_REG4: [0][0][Zen_G][Yen_G][Xen_G][0][LIR_XL1][4D_XL1]
+	static constexpr uint8_t ctrl_reg4 =
+		(C::gyro_enable_z ? 1<<5 : 0) | (C::gyro_enable_y ? 1<<4 : 0) | (C::gyro_enable_x ? 1<<3 : 0) |
+		(C::gyro_latch_interrupt ? 1<<1 : 0);
+	// ORIENT_CFG_G: [0][0][SignX_G][SignY_G][SignZ_G][Orient_2][Orient_1][Orient_0]
+	static constexpr uint8_t orient_cfg_g =
+		(C::gyro_flip_x ? 1<<5 : 0) | (C::gyro_flip_y ? 1<<4 : 0) | (C::gyro_flip_z ? 1<<3 : 0) |
+		(C::gyro_orientation & 0x7);
+	// CTRL_REG5_XL: [DEC_1][DEC_0][Zen_XL][Yen_XL][Xen_XL][0][0][0]
+	static constexpr uint8_t ctrl_reg5_xl =
+		(C::accel_enable_z ? 1<<5 : 0) | (C::accel_enable_y ? 1<<4 : 0) | (C::accel_enable_x ? 1<<3 : 0);
+	// CTRL_REG6_XL: [ODR_XL2][ODR_XL1][ODR_XL0][FS1_XL][FS0_XL][BW_SCAL_ODR][BW_XL1][BW_XL0]
+	static constexpr uint8_t ctrl_reg6_xl =
+		(C::accel_enabled ? (C::accel_sample_rate & 0x07) << 5 : 0) |
+		(C::accel_scale == 4 ? 0x2 << 3 : C::accel_scale == 8 ? 0x3 << 3 : C::accel_scale == 16 ? 0x1 << 3 : 0) |
+		(C::accel_bandwidth >= 0 ? (1<<2) | (C::accel_bandwidth & 0x03) : 0);
+	// CTRL_REG7_XL: [HR][DCF1][DCF0][0][0][FDS][0][HPIS1]
+	static constexpr uint8_t ctrl_reg7_xl =
+		C::accel_highres_enable ? (1<<7) | (C::accel_highres_bandwidth & 0x3) << 5 : 0;
+	// CTRL_REG1_M: [TEMP_COMP][OM1][OM0][DO2][DO1][DO0][0][ST]
+	static constexpr uint8_t ctrl_reg1_m =
+		(C::mag_temp_compensation_enable ? 1<<7 : 0) |
+		(C::mag_xy_performance & 0x3) << 5 |
+		(C::mag_sample_rate & 0x7) << 2;
+	// CTRL_REG2_M: [0][FS1][FS0][0][REBOOT][SOFT_RST][0][0]
+	static constexpr uint8_t ctrl_reg2_m =
+		C::mag_scale == 8 ? 0x1 << 5 : C::mag_scale == 12 ? 0x2 << 5 : C::mag_scale == 16 ? 0x3 << 5 : 0;
+	// CTRL_REG3_M: [I2C_DISABLE][0][LP][0][0][SIM][MD1][MD0]
+	// (I2C_DISABLE is added when the sensor is on SPI)
+	static constexpr uint8_t ctrl_reg3_m =
+		(C::mag_lowpower_enable ? 1<<5 : 0) | (C::mag_operating_mode & 0x3);
+	// CTRL_REG4_M: [0][0][0][0][OMZ1][OMZ0][BLE][0]
+	static constexpr uint8_t ctrl_reg4_m = (C::mag_z_performance & 0x3) << 2;
+
+	// Written in this order by write_image()
+	static constexpr LSM9DS1_REGISTER ag[] = {
+		{ CTRL_REG1_G, ctrl_reg1_g },
+		{ CTRL_REG2_G, 0x00 },
+		{ CTRL_REG3_G, ctrl_reg3_g },
+		{ CTRL_REG4, ctrl_reg4 },
+		{ ORIENT_CFG_G, orient_cfg_g },
+		{ CTRL_REG5_XL, ctrl_reg5_xl },
+		{ CTRL_REG6_XL, ctrl_reg6_xl },
+		{ CTRL_REG7_XL, ctrl_reg7_xl },
+	};
+	static constexpr LSM9DS1_REGISTER m[] = {
+		{ CTRL_REG1_M, ctrl_reg1_m },
+		{ CTRL_REG2_M, ctrl_reg2_m },
+		{ CTRL_REG3_M, ctrl_reg3_m },
+		{ CTRL_REG4_M, ctrl_reg4_m },
+		{ CTRL_REG5_M, 0x00 },
+	};
+
+	static constexpr IMU_SETTINGS settings = {
+		{
+			C::gyro_enabled, C::gyro_scale, C::gyro_sample_rate, C::gyro_bandwidth,
+			C::gyro_lowpower_enable, C::gyro_hpf_enable, C::gyro_hpf_cutoff,
+			C::gyro_flip_x, C::gyro_flip_y, C::gyro_flip_z, C::gyro_orientation,
+			C::gyro_enable_x, C::gyro_enable_y, C::gyro_enable_z, C::gyro_latch_interrupt,
+		},
+		{
+			C::accel_enabled, C::accel_scale, C::accel_sample_rate,
+			C::accel_enable_x, C::accel_enable_y, C::accel_enable_z,
+			C::accel_bandwidth, C::accel_highres_enable, C::accel_highres_bandwidth,
+		},
+		{
+			C::mag_enabled, C::mag_scale, C::mag_sample_rate, C::mag_temp_compensation_enable,
+			C::mag_xy_performance, C::mag_z_performance, C::mag_lowpower_enable, C::mag_operating_mode,
+		},
+		C::temp_enabled,
+	};
+
+	static constexpr float res_a =
+		C::accel_scale == 2 ? SENSITIVITY_ACCELEROMETER_2 :
+		C::accel_scale == 4 ? SENSITIVITY_ACCELEROMETER_4 :
+		C::accel_scale == 8 ? SENSITIVITY_ACCELEROMETER_8 : SENSITIVITY_ACCELEROMETER_16;
+	static constexpr float res_g = TO_RAD * (
+		C::gyro_scale == 245 ? SENSITIVITY_GYROSCOPE_245 :
+		C::gyro_scale == 500 ? SENSITIVITY_GYROSCOPE_500 : SENSITIVITY_GYROSCOPE_2000);
+	static constexpr float res_m =
+		C::mag_scale == 4 ? SENSITIVITY_MAGNETOMETER_4 :
+		C::mag_scale == 8 ? SENSITIVITY_MAGNETOMETER_8 :
+		C::mag_scale == 12 ? SENSITIVITY_MAGNETOMETER_12 : SENSITIVITY_MAGNETOMETER_16;
+};
+
+template<class C> constexpr LSM9DS1_REGISTER LSM9DS1_IMAGE<C>::ag[];
+template<class C> constexpr LSM9DS1_REGISTER LSM9DS1_IMAGE<C>::m[];
+template<class C> constexpr IMU_SETTINGS LSM9DS1_IMAGE<C>::settings;
+
+typedef LSM9DS1_IMAGE<LSM9DS1_CONFIG> IMAGE;
+
+LSM9DS1::LSM9DS1() {
+	error_count = 0;
+	recover_count = 0;
+	_bias_loaded_m = false;
+	_error_streak = 0;
+	_recovering = false;
+}
+
+uint16_t LSM9DS1::begin(uint8_t addr_ag, uint8_t addr_m) {
+	return begin(addr_ag, addr_m, Wire, SDA, SCL);
+}
 
 uint16_t LSM9DS1::begin(uint8_t addr_ag, uint8_t addr_m, TwoWire &port) {
+	return begin(addr_ag, addr_m, port, SDA, SCL);
+}
+
+uint16_t LSM9DS1::begin(uint8_t addr_ag, uint8_t addr_m, TwoWire &port, int sda, int scl) {
 	_addr_ag = addr_ag;
 	_addr_m = addr_m;
 	_port = &port;
+	_sda = sda;
+	_scl = scl;
+	_spi = nullptr;
+	return begin_common();
+}
 
-	init();
+uint16_t LSM9DS1::begin_spi(uint8_t cs_ag, uint8_t cs_m) {
+	return begin_spi(cs_ag, cs_m, SPI);
+}
 
-	constrain_scales();
+uint16_t LSM9DS1::begin_spi(uint8_t cs_ag, uint8_t cs_m, SPIClass &port) {
+	_addr_ag = cs_ag;
+	_addr_m = cs_m;
+	_port = nullptr;
+	_spi = &port;
+	pinMode(cs_ag, OUTPUT);
+	pinMode(cs_m, OUTPUT);
+	digitalWrite(cs_ag, HIGH);
+	digitalWrite(cs_m, HIGH);
+	_spi->begin();
+	return begin_common();
+}
 
-	calc_res_g(); // Calculate DPS / ADC tick, stored in _res_g variable
-	calc_res_m(); // Calculate Gs / ADC tick, stored in _res_m variable
-	calc_res_a(); // Calculate g / ADC tick, stored in _res_a variable
+uint16_t LSM9DS1::begin_common() {
+	init();
 
 	uint8_t test_m = read_m(WHO_AM_I_M);
 	uint8_t test_ag = read_ag(WHO_AM_I_XG);
@@ -123,9 +289,10 @@ uint16_t LSM9DS1::begin(uint8_t addr_ag, uint8_t addr_m, TwoWire &port) {
 		return 0;
 	}
 
-	init_g();
-	init_a();
-	init_m();
+	// A lost write leaves the sensor partly configured
+	if (!write_image()) {
+		return 0;
+	}
 
 	return who_am_i;
 }
@@ -142,47 +309,142 @@ uint8_t LSM9DS1::available_t() {
 	uint8_t status = read_ag(STATUS_REG_1);
 	return ((status & (1<<2)) >> 2);
 }
+uint8_t LSM9DS1::available_ag() {
+	uint8_t status = read_ag(STATUS_REG_1);
+	return (status & (LSM9DS1_AVAILABLE_A | LSM9DS1_AVAILABLE_G));
+}
 uint8_t LSM9DS1::available_m(LSM9DS1_AXIS axis) {
 	uint8_t status;
 	status = read_m(STATUS_REG_M);
 	return ((status & (1<<axis)) >> axis);
 }
 
-void LSM9DS1::read_a() {
+bool LSM9DS1::read_a() {
 	uint8_t temp[6];
-	if (6 == i2c_read_bytes(_addr_ag, OUT_X_L_XL, temp, 6)) {
+	if (6 == read_bytes(_addr_ag, OUT_X_L_XL, temp, 6)) {
 		ax = (temp[1] << 8) | temp[0];
 		ay = (temp[3] << 8) | temp[2];
 		az = (temp[5] << 8) | temp[4];
+		return true;
 	}
+	return false;
 }
-void LSM9DS1::read_g() {
+bool LSM9DS1::read_g() {
 	uint8_t temp[6];
-	if (6 == i2c_read_bytes(_addr_ag, OUT_X_L_G, temp, 6)) {
+	if (6 == read_bytes(_addr_ag, OUT_X_L_G, temp, 6)) {
 		gx = (temp[1] << 8) | temp[0];
 		gy = (temp[3] << 8) | temp[2];
 		gz = (temp[5] << 8) | temp[4];
-		gx *= _res_g;
-		gy *= _res_g;
-		gz *= _res_g;
+		return true;
 	}
+	return false;
 }
-void LSM9DS1::read_t() {
+bool LSM9DS1::read_t() {
 	uint8_t temp[2];
-	if (2 == i2c_read_bytes(_addr_ag, OUT_TEMP_L, temp, 2)) {
+	if (2 == read_bytes(_addr_ag, OUT_TEMP_L, temp, 2)) {
 		int16_t offset = 25;  // Per datasheet sensor outputs 0 typically @ 25 degrees centigrade
 		temperature = offset + ((((int16_t)temp[1] << 8) | temp[0]) >> 8) ;
+		return true;
 	}
+	return false;
 }
-void LSM9DS1::read_m() {
+bool LSM9DS1::read_m() {
 	uint8_t temp[6];
-	if (6 == i2c_read_bytes(_addr_m, OUT_X_L_M, temp, 6)) {
+	if (6 == read_bytes(_addr_m, OUT_X_L_M, temp, 6)) {
 		mx = (temp[1] << 8) | temp[0];
 		my = (temp[3] << 8) | temp[2];
 		mz = (temp[5] << 8) | temp[4];
+		return true;
+	}
+	return false;
+}
+
+bool LSM9DS1::recover() {
+	recover_count++;
+	_error_streak = 0;
+	_recovering = true;
+	// SPI has no bus state to clear, only the settings are restored
+	bool ret = (_spi != nullptr) ? reinit() : recover_i2c();
+	// The next recover() needs LSM9DS1_RECOVER_ERRORS new failures
+	_error_streak = 0;
+	_recovering = false;
+	return ret;
+}
+
+bool LSM9DS1::recover_i2c() {
+	uint32_t clock = _port->getClock();
+	// Detach the pins from the I2C peripheral (begin() does nothing on a
+	// port that is still running)
+	_port->end();
+	// Clock SCL until the slave releases SDA (at most 9 bits)
+	pinMode(_sda, INPUT_PULLUP);
+	pinMode(_scl, OUTPUT_OPEN_DRAIN);
+	digitalWrite(_scl, HIGH);
+	for (int i = 0; i < 9 && digitalRead(_sda) == LOW; i++) {
+		delayMicroseconds(5);
+		digitalWrite(_scl, LOW);
+		delayMicroseconds(5);
+		digitalWrite(_scl, HIGH);
+	}
+	// STOP: with SCL low pull SDA low, then release SCL and let SDA rise
+	delayMicroseconds(5);
+	digitalWrite(_scl, LOW);
+	delayMicroseconds(5);
+	pinMode(_sda, OUTPUT_OPEN_DRAIN);
+	digitalWrite(_sda, LOW);
+	delayMicroseconds(5);
+	digitalWrite(_scl, HIGH);
+	delayMicroseconds(5);
+	digitalWrite(_sda, HIGH);
+	delayMicroseconds(5);
+	// Restart the port on the same pins and restore the sensor settings
+	_port->begin(_sda, _scl, clock);
+	return reinit();
+}
+
+bool LSM9DS1::reinit() {
+	uint8_t test_m = read_m(WHO_AM_I_M);
+	uint8_t test_ag = read_ag(WHO_AM_I_XG);
+	if (test_m != WHO_AM_I_M_RSP || test_ag != WHO_AM_I_AG_RSP) {
+		return false;
+	}
+	bool written = write_image();
+	// Scales and rates changed at run time since begin()
+	if (settings.gyro.scale != IMAGE::settings.gyro.scale) set_scale_g(settings.gyro.scale);
+	if (settings.accel.scale != IMAGE::settings.accel.scale) set_scale_a(settings.accel.scale);
+	if (settings.mag.scale != IMAGE::settings.mag.scale) set_scale_m(settings.mag.scale);
+	if (settings.gyro.sample_rate != IMAGE::settings.gyro.sample_rate) set_odr_g(settings.gyro.sample_rate);
+	if (settings.accel.sample_rate != IMAGE::settings.accel.sample_rate) set_odr_a(settings.accel.sample_rate);
+	if (settings.mag.sample_rate != IMAGE::settings.mag.sample_rate) set_odr_m(settings.mag.sample_rate);
+	if (_bias_loaded_m) {
+		for (int i = 0; i < 3; i++) {
+			offset_m(i, _bias_raw_m[i]);
+		}
 	}
+	return written;
 }
 
+bool LSM9DS1::check() {
+	uint32_t errors = error_count;
+	bool ok = read_m(WHO_AM_I_M) == WHO_AM_I_M_RSP && read_ag(WHO_AM_I_XG) == WHO_AM_I_AG_RSP;
+	if (ok && _spi != nullptr) {
+		ok = 0 != (read_ag(CTRL_REG9) & (1<<2));
+	}
+	if (ok) {
+		return true;
+	}
+	// A failed I2C transfer was already counted by bus_error()
+	if (error_count == errors) {
+		INSTRUMENT_I2C_ERROR();
+		error_count++;
+	}
+	return recover();
+}
+
+float LSM9DS1::calc_g(int16_t gyro) {
+	// Return the gyro raw reading times our pre-calculated rad/s / (ADC tick):
+	return _res_g * gyro;
+}
 float LSM9DS1::calc_a(int16_t accel) {
 	// Return the accel raw reading times our pre-calculated g's / (ADC tick):
 	return _res_a * accel;
@@ -314,7 +576,7 @@ void LSM9DS1::calibrate_ag() {
 	uint8_t samples = 0;
 	int ii;
 	int32_t temp_bias_a[3] = {0, 0, 0};
-	float temp_bias_g[3] = {0, 0, 0};
+	int32_t temp_bias_g[3] = {0, 0, 0};
 	// Turn on FIFO and set threshold to 32 samples
 	enable_fifo(true);
 	set_fifo(FIFO_THS, 0x1F);
@@ -334,7 +596,7 @@ void LSM9DS1::calibrate_ag() {
 	}
 	for (ii = 0; ii < 3; ii++) {
 		bias_a[ii] = calc_a(temp_bias_a[ii] / samples);
-		bias_g[ii] = temp_bias_g[ii] / samples;
+		bias_g[ii] = calc_g(temp_bias_g[ii] / samples);
 	}
 	enable_fifo(false);
 	set_fifo(FIFO_OFF, 0x00);
@@ -362,6 +624,7 @@ void LSM9DS1::calibrate_m(bool loadIn) {
 		if (loadIn)
 			offset_m(j, _bias_raw_m[j]);
 	}
+	_bias_loaded_m = loadIn;
 }
 void LSM9DS1::offset_m(uint8_t axis, int16_t offset) {
 	if (axis > 2)
@@ -375,79 +638,10 @@ void LSM9DS1::offset_m(uint8_t axis, int16_t offset) {
 
 
 void LSM9DS1::init() {
-	settings.gyro.enabled = true;
-	settings.gyro.enable_x = true;
-	settings.gyro.enable_y = true;
-	settings.gyro.enable_z = true;
-	// gyro scale can be 245, 500, or 2000
-	settings.gyro.scale = 245;
-	// gyro sample rate: value between 1-6
-	// 1 = 14.9    4 = 238
-	// 2 = 59.5    5 = 476
-	// 3 = 119     6 = 952
-	settings.gyro.sample_rate = 6;
-	// gyro cutoff frequency: value between 0-3
-	// Actual value of cutoff frequency depends
-	// on sample rate.
-	settings.gyro.bandwidth = 0;
-	settings.gyro.lowpower_enable = false;
-	settings.gyro.hpf_enable = false;
-	// Gyro HPF cutoff frequency: value between 0-9
-	// Actual value depends on sample rate. Only applies
-	// if gyroHPFEnable is true.
-	settings.gyro.hpf_cutoff = 0;
-	settings.gyro.flip_x = false;
-	settings.gyro.flip_y = false;
-	settings.gyro.flip_z = false;
-	settings.gyro.orientation = 0;
-	settings.gyro.latch_interrupt = true;
-
-	settings.accel.enabled = true;
-	settings.accel.enable_x = true;
-	settings.accel.enable_y = true;
-	settings.accel.enable_z = true;
-	// accel scale can be 2, 4, 8, or 16
-	settings.accel.scale = 2;
-	// accel sample rate can be 1-6
-	// 1 = 10 Hz    4 = 238 Hz
-	// 2 = 50 Hz    5 = 476 Hz
-	// 3 = 119 Hz   6 = 952 Hz
-	settings.accel.sample_rate = 6;
-	// Accel cutoff freqeuncy can be any value between -1 - 3. 
-	// -1 = bandwidth determined by sample rate
-	// 0 = 408 Hz   2 = 105 Hz
-	// 1 = 211 Hz   3 = 50 Hz
-	settings.accel.bandwidth = -1;
-	settings.accel.highres_enable = false;
-	// accelHighResBandwidth can be any value between 0-3
-	// LP cutoff is set to a factor of sample rate
-	// 0 = ODR/50    2 = ODR/9
-	// 1 = ODR/100   3 = ODR/400
-	settings.accel.highres_bandwidth = 0;
-
-	settings.mag.enabled = true;
-	// mag scale can be 4, 8, 12, or 16
-	settings.mag.scale = 4;
-	// mag data rate can be 0-7
-	// 0 = 0.625 Hz  4 = 10 Hz
-	// 1 = 1.25 Hz   5 = 20 Hz
-	// 2 = 2.5 Hz    6 = 40 Hz
-	// 3 = 5 Hz      7 = 80 Hz
-	settings.mag.sample_rate = 7;
-	settings.mag.temp_compensation_enable = false;
-	// magPerformance can be any value between 0-3
-	// 0 = Low power mode      2 = high performance
-	// 1 = medium performance  3 = ultra-high performance
-	settings.mag.xy_performance = 3;
-	settings.mag.z_performance = 3;
-	settings.mag.lowpower_enable = false;
-	// magOperatingMode can be 0-2
-	// 0 = continuous conversion
-	// 1 = single-conversion
-	// 2 = power down
-	settings.mag.operating_mode = 0;
-
-	settings.temp_enabled = true;
+	settings = IMAGE::settings;
+	_res_a = IMAGE::res_a;
+	_res_g = IMAGE::res_g;
+	_res_m = IMAGE::res_m;
 	for (int i=0; i<3; i++) {
 		bias_g[i] = 0;
 		bias_a[i] = 0;
@@ -455,220 +649,22 @@ void LSM9DS1::init() {
 		_bias_raw_m[i] = 0;
 	}
 }
-void LSM9DS1::init_a() {
-	uint8_t temp_reg = 0;
-
-	//	CTRL_REG5_XL (0x1F) (Default value: 0x38)
-	//	[DEC_1][DEC_0][Zen_XL][Yen_XL][Zen_XL][0][0][0]
-	//	DEC[0:1] - Decimation of accel data on OUT REG and FIFO.
-	//		00: None, 01: 2 samples, 10: 4 samples 11: 8 samples
-	//	Zen_XL - Z-axis output enabled
-	//	Yen_XL - Y-axis output enabled
-	//	Xen_XL - X-axis output enabled
-	if (settings.accel.enable_z) temp_reg |= (1<<5);
-	if (settings.accel.enable_y) temp_reg |= (1<<4);
-	if (settings.accel.enable_x) temp_reg |= (1<<3);
-
-	write_ag(CTRL_REG5_XL, temp_reg);
-
-	// CTRL_REG6_XL (0x20) (Default value: 0x00)
-	// [ODR_XL2][ODR_XL1][ODR_XL0][FS1_XL][FS0_XL][BW_SCAL_ODR][BW_XL1][BW_XL0]
-	// ODR_XL[2:0] - Output data rate & power mode selection
-	// FS_XL[1:0] - Full-scale selection
-	// BW_SCAL_ODR - Bandwidth selection
-	// BW_XL[1:0] - Anti-aliasing filter bandwidth selection
-	temp_reg = 0;
-	// To disable the accel, set the sampleRate bits to 0.
-	if (settings.accel.enabled) {
-		temp_reg |= (settings.accel.sample_rate & 0x07) << 5;
+bool LSM9DS1::write_image() {
+	bool written = true;
+	for (const LSM9DS1_REGISTER &r : IMAGE::ag) {
+		written &= write_ag(r.addr, r.value);
 	}
-	switch (settings.accel.scale) {
-	case 4:
-		temp_reg |= (0x2 << 3);
-		break;
-	case 8:
-		temp_reg |= (0x3 << 3);
-		break;
-	case 16:
-		temp_reg |= (0x1 << 3);
-		break;
-	// Otherwise it'll be set to 2g (0x0 << 3)
-	}
-	if (settings.accel.bandwidth >= 0) {
-		temp_reg |= (1<<2); // Set BW_SCAL_ODR
-		temp_reg |= (settings.accel.bandwidth & 0x03);
-	}
-	write_ag(CTRL_REG6_XL, temp_reg);
-
-	// CTRL_REG7_XL (0x21) (Default value: 0x00)
-	// [HR][DCF1][DCF0][0][0][FDS][0][HPIS1]
-	// HR - High resolution mode (0: disable, 1: enable)
-	// DCF[1:0] - Digital filter cutoff frequency
-	// FDS - Filtered data selection
-	// HPIS1 - HPF enabled for interrupt function
-	temp_reg = 0;
-	if (settings.accel.highres_enable) {
-		temp_reg |= (1<<7); // Set HR bit
-		temp_reg |= (settings.accel.highres_bandwidth & 0x3) << 5;
-	}
-	write_ag(CTRL_REG7_XL, temp_reg);
-}
-void LSM9DS1::init_g() {
-	uint8_t temp_reg = 0;
-
-	// CTRL_REG1_G (Default value: 0x00)
-	// [ODR_G2][ODR_G1][ODR_G0][FS_G1][FS_G0][0][BW_G1][BW_G0]
-	// ODR_G[2:0] - Output data rate selection
-	// FS_G[1:0] - Gyroscope full-scale selection
-	// BW_G[1:0] - Gyroscope bandwidth selection
-
-	// To disable gyro, set sample rate bits to 0. We'll only set sample
-	// rate if the gyro is enabled.
-	if (settings.gyro.enabled) {
-		temp_reg = (settings.gyro.sample_rate & 0x07) << 5;
+	for (const LSM9DS1_REGISTER &r : IMAGE::m) {
+		// I2C_DISABLE in CTRL_REG3_M when the sensor is on SPI
+		written &= write_m(r.addr, (CTRL_REG3_M == r.addr && _spi != nullptr) ? (r.value | (1<<7)) : r.value);
 	}
-	switch (settings.gyro.scale) {
-	case 500:
-		temp_reg |= (0x1 << 3);
-		break;
-	case 2000:
-		temp_reg |= (0x3 << 3);
-		break;
-	// Otherwise we'll set it to 245 dps (0x0 << 4)
-	}
-	temp_reg |= (settings.gyro.bandwidth & 0x3);
-	write_ag(CTRL_REG1_G, temp_reg);
-
-	// CTRL_REG2_G (Default value: 0x00)
-	// [0][0][0][0][INT_SEL1][INT_SEL0][OUT_SEL1][OUT_SEL0]
-	// INT_SEL[1:0] - INT selection configuration
-	// OUT_SEL[1:0] - Out selection configuration
-	write_ag(CTRL_REG2_G, 0x00);	
-
-	// CTRL_REG3_G (Default value: 0x00)
-	// [LP_mode][HP_EN][0][0][HPCF3_G][HPCF2_G][HPCF1_G][HPCF0_G]
-	// LP_mode - Low-power mode enable (0: disabled, 1: enabled)
-	// HP_EN - HPF enable (0:disabled, 1: enabled)
-	// HPCF_G[3:0] - HPF cutoff frequency
-	temp_reg = settings.gyro.lowpower_enable ? (1<<7) : 0;
-	if (settings.gyro.hpf_enable) {
-		temp_reg |= (1<<6) | (settings.gyro.hpf_cutoff & 0x0F);
-	}
-	write_ag(CTRL_REG3_G, temp_reg);
-
-	// CTRL_REG4 (Default value: 0x38)
-	// [0][0][Zen_G][Yen_G][Xen_G][0][LIR_XL1][4D_XL1]
-	// Zen_G - Z-axis output enable (0:disable, 1:enable)
-	// Yen_G - Y-axis output enable (0:disable, 1:enable)
-	// Xen_G - X-axis output enable (0:disable, 1:enable)
-	// LIR_XL1 - Latched interrupt (0:not latched, 1:latched)
-	// 4D_XL1 - 4D option on interrupt (0:6D used, 1:4D used)
-	temp_reg = 0;
-	if (settings.gyro.enable_z) temp_reg |= (1<<5);
-	if (settings.gyro.enable_y) temp_reg |= (1<<4);
-	if (settings.gyro.enable_x) temp_reg |= (1<<3);
-	if (settings.gyro.latch_interrupt) temp_reg |= (1<<1);
-	write_ag(CTRL_REG4, temp_reg);
-
-	// ORIENT_CFG_G (Default value: 0x00)
-	// [0][0][SignX_G][SignY_G][SignZ_G][Orient_2][Orient_1][Orient_0]
-	// SignX_G - Pitch axis (X) angular rate sign (0: positive, 1: negative)
-	// Orient [2:0] - Directional user orientation selection
-	temp_reg = 0;
-	if (settings.gyro.flip_x) temp_reg |= (1<<5);
-	if (settings.gyro.flip_y) temp_reg |= (1<<4);
-	if (settings.gyro.flip_z) temp_reg |= (1<<3);
-	write_ag(ORIENT_CFG_G, temp_reg);
-}
-void LSM9DS1::init_m() {
-	uint8_t temp_reg = 0;
-
-	// CTRL_REG1_M (Default value: 0x10)
-	// [TEMP_COMP][OM1][OM0][DO2][DO1][DO0][0][ST]
-	// TEMP_COMP - Temperature compensation
-	// OM[1:0] - X & Y axes op mode selection
-	//	00:low-power, 01:medium performance
-	//	10: high performance, 11:ultra-high performance
-	// DO[2:0] - Output data rate selection
-	// ST - Self-test enable
-	if (settings.mag.temp_compensation_enable) temp_reg |= (1<<7);
-	temp_reg |= (settings.mag.xy_performance & 0x3) << 5;
-	temp_reg |= (settings.mag.sample_rate & 0x7) << 2;
-	write_m(CTRL_REG1_M, temp_reg);
-
-	// CTRL_REG2_M (Default value 0x00)
-	// [0][FS1][FS0][0][REBOOT][SOFT_RST][0][0]
-	// FS[1:0] - Full-scale configuration
-	// REBOOT - Reboot memory content (0:normal, 1:reboot)
-	// SOFT_RST - Reset config and user registers (0:default, 1:reset)
-	temp_reg = 0;
-	switch (settings.mag.scale) {
-	case 8:
-		temp_reg |= (0x1 << 5);
-		break;
-	case 12:
-		temp_reg |= (0x2 << 5);
-		break;
-	case 16:
-		temp_reg |= (0x3 << 5);
-		break;
-	// Otherwise we'll default to 4 gauss (00)
-	}
-	write_m(CTRL_REG2_M, temp_reg); // +/-4Gauss
-
-	// CTRL_REG3_M (Default value: 0x03)
-	// [I2C_DISABLE][0][LP][0][0][SIM][MD1][MD0]
-	// I2C_DISABLE - Disable I2C interace (0:enable, 1:disable)
-	// LP - Low-power mode cofiguration (1:enable)
-	// SIM - SPI mode selection (0:write-only, 1:read/write enable)
-	// MD[1:0] - Operating mode
-	//	00:continuous conversion, 01:single-conversion,
-	//  10,11: Power-down
-	temp_reg = 0;
-	if (settings.mag.lowpower_enable) temp_reg |= (1<<5);
-	temp_reg |= (settings.mag.operating_mode & 0x3);
-	write_m(CTRL_REG3_M, temp_reg); // Continuous conversion mode
-
-	// CTRL_REG4_M (Default value: 0x00)
-	// [0][0][0][0][OMZ1][OMZ0][BLE][0]
-	// OMZ[1:0] - Z-axis operative mode selection
-	//	00:low-power mode, 01:medium performance
-	//	10:high performance, 10:ultra-high performance
-	// BLE - Big/little endian data
-	temp_reg = 0;
-	temp_reg = (settings.mag.z_performance & 0x3) << 2;
-	write_m(CTRL_REG4_M, temp_reg);
-
-	// CTRL_REG5_M (Default value: 0x00)
-	// [0][BDU][0][0][0][0][0][0]
-	// BDU - Block data update for magnetic data
-	//	0:continuous, 1:not updated until MSB/LSB are read
-	temp_reg = 0;
-	write_m(CTRL_REG5_M, temp_reg);
-}
-
-void LSM9DS1::constrain_scales() {
-	if ((settings.gyro.scale != 245) &&
-		(settings.gyro.scale != 500) && 
-		(settings.gyro.scale != 2000)
-	) {
-		settings.gyro.scale = 245;
-	}
-	if ((settings.accel.scale != 2) &&
-		(settings.accel.scale != 4) &&
-		(settings.accel.scale != 8) &&
-		(settings.accel.scale != 16)
-	) {
-		settings.accel.scale = 2;
-	}
-	if ((settings.mag.scale != 4) &&
-		(settings.mag.scale != 8) &&
-		(settings.mag.scale != 12) &&
-		(settings.mag.scale != 16)
-	) {
-		settings.mag.scale = 4;
+	if (_spi != nullptr) {
+		// I2C_DISABLE in CTRL_REG9 (the other bits are the FIFO settings)
+		written &= write_ag(CTRL_REG9, read_ag(CTRL_REG9) | (1<<2));
 	}
+	return written;
 }
+
 void LSM9DS1::calc_res_a() {
 	switch (settings.accel.scale) {
 	case 2:
@@ -721,51 +717,141 @@ void LSM9DS1::calc_res_m() {
 
 uint8_t LSM9DS1::read_ag(uint8_t addr_sub) {
 	uint8_t data;
-	_port->beginTransmission(_addr_ag);
-	_port->write(addr_sub);
-	_port->endTransmission(false);
-	_port->requestFrom(_addr_ag, (uint8_t) 1);
-	data = _port->read();
+	if (1 != read_bytes(_addr_ag, addr_sub, &data, 1)) {
+		return 0;
+	}
 	return data;
 }
 uint8_t LSM9DS1::read_m(uint8_t addr_sub) {
 	uint8_t data;
-	_port->beginTransmission(_addr_m);
-	_port->write(addr_sub);
-	_port->endTransmission(false);
-	_port->requestFrom(_addr_m, (uint8_t) 1);
-	data = _port->read();
+	if (1 != read_bytes(_addr_m, addr_sub, &data, 1)) {
+		return 0;
+	}
 	return data;
 }
-void LSM9DS1::write_ag(uint8_t addr_sub, uint8_t data) {
-	_port->beginTransmission(_addr_ag);
-	_port->write(addr_sub);
-	_port->write(data);
-	_port->endTransmission();
+bool LSM9DS1::write_ag(uint8_t addr_sub, uint8_t data) {
+	return write_byte(_addr_ag, addr_sub, data);
 }
-void LSM9DS1::write_m(uint8_t addr_sub, uint8_t data) {
-	_port->beginTransmission(_addr_m);
-	_port->write(addr_sub);
-	_port->write(data);
-	_port->endTransmission();
+bool LSM9DS1::write_m(uint8_t addr_sub, uint8_t data) {
+	return write_byte(_addr_m, addr_sub, data);
+}
+#ifdef LSM9DS1_FAULT_INJECT
+// Fault injection: fail every LSM9DS1_FAULT_INJECT-th I2C transfer (reads and writes)
+static bool fault_inject() {
+	static uint16_t fault_count = 0;
+	if (++fault_count >= LSM9DS1_FAULT_INJECT) {
+		fault_count = 0;
+		return true;
+	}
+	return false;
 }
+#else
+static inline bool fault_inject() {
+	return false;
+}
+#endif
 uint8_t LSM9DS1::i2c_read_bytes(uint8_t address, uint8_t addr_sub, uint8_t * dest, uint8_t count) {
 	uint8_t ret;
+	if (fault_inject()) {
+		bus_error();
+		return 0;
+	}
 	_port->beginTransmission(address);
 	_port->write(addr_sub | 0x80);
 	ret = _port->endTransmission(false);
 	if (ret != 0) {
+		bus_error();
 		return 0;
 	}
 	ret = _port->requestFrom(address, count);
 	if (ret != count) {
+		bus_error();
 		return 0;
 	}
 	for (int i=0; i<count;) {
 		dest[i++] = _port->read();
 	}
+	_error_streak = 0;
+	return count;
+}
+bool LSM9DS1::i2c_write_byte(uint8_t address, uint8_t addr_sub, uint8_t data) {
+	if (fault_inject()) {
+		bus_error();
+		return false;
+	}
+	_port->beginTransmission(address);
+	_port->write(addr_sub);
+	_port->write(data);
+	if (_port->endTransmission() != 0) {
+		bus_error();
+		return false;
+	}
+	_error_streak = 0;
+	return true;
+}
+uint8_t LSM9DS1::spi_read_bytes(uint8_t address, uint8_t addr_sub, uint8_t * dest, uint8_t count) {
+	// Send the register address and clock the data out in one FIFO transfer
+	uint8_t tx[LSM9DS1_SPI_BURST_MAX + 1];
+	uint8_t rx[LSM9DS1_SPI_BURST_MAX + 1];
+	if (count > LSM9DS1_SPI_BURST_MAX) {
+		count = LSM9DS1_SPI_BURST_MAX;
+	}
+	// Bit 7: read, bit 6 (mag only): auto-increment the address
+	tx[0] = addr_sub | 0x80;
+	if (address == _addr_m && count > 1) {
+		tx[0] |= 0x40;
+	}
+	memset(tx + 1, 0, count);
+	_spi->beginTransaction(SPISettings(LSM9DS1_SPI_CLOCK, MSBFIRST, SPI_MODE3));
+	digitalWrite(address, LOW);
+	_spi->transferBytes(tx, rx, count + 1);
+	digitalWrite(address, HIGH);
+	_spi->endTransaction();
+	memcpy(dest, rx + 1, count);
 	return count;
 }
+void LSM9DS1::spi_write_byte(uint8_t address, uint8_t addr_sub, uint8_t data) {
+	_spi->beginTransaction(SPISettings(LSM9DS1_SPI_CLOCK, MSBFIRST, SPI_MODE3));
+	digitalWrite(address, LOW);
+	_spi->transfer(addr_sub & 0x3F);
+	_spi->transfer(data);
+	digitalWrite(address, HIGH);
+	_spi->endTransaction();
+}
+uint8_t LSM9DS1::read_bytes(uint8_t address, uint8_t addr_sub, uint8_t * dest, uint8_t count) {
+	INSTRUMENT_BUS_BEGIN();
+	uint8_t ret;
+	if (_spi != nullptr) {
+		ret = spi_read_bytes(address, addr_sub, dest, count);
+	} else {
+		ret = i2c_read_bytes(address, addr_sub, dest, count);
+	}
+	INSTRUMENT_BUS_END();
+	return ret;
+}
+bool LSM9DS1::write_byte(uint8_t address, uint8_t addr_sub, uint8_t data) {
+	INSTRUMENT_BUS_BEGIN();
+	bool ret = true;
+	if (_spi != nullptr) {
+		spi_write_byte(address, addr_sub, data);
+	} else {
+		// A lost register write is retried (reads are simply repeated by the next sample)
+		ret = i2c_write_byte(address, addr_sub, data);
+		for (int i = 1; !ret && i < LSM9DS1_WRITE_TRIES; i++) {
+			ret = i2c_write_byte(address, addr_sub, data);
+		}
+	}
+	INSTRUMENT_BUS_END();
+	return ret;
+}
+void LSM9DS1::bus_error() {
+	INSTRUMENT_I2C_ERROR();
+	error_count++;
+	// Failures during recover() are counted but do not start another one
+	if (++_error_streak >= LSM9DS1_RECOVER_ERRORS && !_recovering) {
+		recover();
+	}
+}
 
 void LSM9DS1::enable_fifo(bool enable) {
 	uint8_t temp = read_ag(CTRL_REG9);
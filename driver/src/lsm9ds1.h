@@ -6,34 +6,61 @@
 #define LSM9DS1_AG_ADDR(sa0)	((sa0) == 0 ? 0x6A : 0x6B)
 #define LSM9DS1_M_ADDR(sa1)		((sa1) == 0 ? 0x1C : 0x1E)
 
+// Consecutive transfer failures that trigger recover()
+#define LSM9DS1_RECOVER_ERRORS	3
+// Attempts for one register write over I2C
+#define LSM9DS1_WRITE_TRIES		2
+
+// Bits returned by available_ag()
+#define LSM9DS1_AVAILABLE_A		(1<<0)
+#define LSM9DS1_AVAILABLE_G		(1<<1)
+
+// SPI clock (the LSM9DS1 supports up to 10 MHz)
+#define LSM9DS1_SPI_CLOCK		10000000
+// Longest burst read over SPI (bytes)
+#define LSM9DS1_SPI_BURST_MAX	6
+
 struct TwoWire;
+class SPIClass;
 
 class LSM9DS1 {
 public:
 	IMU_SETTINGS settings;
-	float gx, gy, gz;
+	int16_t gx, gy, gz;
 	int16_t ax, ay, az;
 	int16_t mx, my, mz;
 	int16_t temperature;
 	float bias_a[3];
 	float bias_g[3];
 	float bias_m[3];
+	// Bus failures (failed transfers) and bus recoveries since begin()
+	uint32_t error_count;
+	uint32_t recover_count;
 
 protected:
 	TwoWire *_port;
+	// I2C pins of _port (used by recover())
+	int _sda, _scl;
+	// SPI port (nullptr when the sensor is on I2C)
+	SPIClass *_spi;
 	uint8_t _addr_ag, _addr_m;
 	// _res_g, _res_a, and _res_m store the current resolution for each sensor. 
 	// Units of these values would be DPS (or g's or Gs's) per ADC tick.
 	// This value is calculated as (sensor scale) / (2^15).
 	float _res_a, _res_g, _res_m;
 	int16_t _bias_raw_m[3];
+	bool _bias_loaded_m;
+	// Consecutive failed transfers (recover() runs at LSM9DS1_RECOVER_ERRORS)
+	uint8_t _error_streak;
+	// recover() is running (failures inside it do not start another one)
+	bool _recovering;
 
 public:
 	LSM9DS1();
 
 	// Initialize the gyro, accelerometer, and magnetometer.
-	// This will set up the scale and output rate of each sensor. The values set
-	// in the IMU_SETTINGS struct will take effect after calling this function.
+	// This will set up the scale and output rate of each sensor from the
+	// compile-time configuration LSM9DS1_CONFIG (see lsm9ds1_config.h).
 	// ## INPUTS
 	// - addr_ag - Sets either the I2C address of the accel/gyro or SPI chip 
 	//   select pin connected to the CS_XG pin.
@@ -41,7 +68,22 @@ public:
 	//   select pin connected to the CS_M pin.
 	// - i2C port (Note, only on "begin()" funtion, for use with I2C com interface)
 	//   defaults to Wire, but if hardware supports it, can use other TwoWire ports.
-	uint16_t begin(uint8_t addr_ag = LSM9DS1_AG_ADDR(1), uint8_t addr_m = LSM9DS1_M_ADDR(1), TwoWire &port = Wire);
+	// - sda, scl - The pins the port was begun on (recover() bit-bangs them),
+	//   default SDA and SCL.
+	// ## Output
+	// - The WHO_AM_I responses (ag << 8 | m), or 0 if the sensor did not
+	//   answer or a register write failed.
+	uint16_t begin(uint8_t addr_ag = LSM9DS1_AG_ADDR(1), uint8_t addr_m = LSM9DS1_M_ADDR(1));
+	uint16_t begin(uint8_t addr_ag, uint8_t addr_m, TwoWire &port);
+	uint16_t begin(uint8_t addr_ag, uint8_t addr_m, TwoWire &port, int sda, int scl);
+	// Same as begin(), but talks to the sensor over 4-wire SPI at LSM9DS1_SPI_CLOCK.
+	// The I2C interfaces of both dies are disabled.
+	// ## INPUTS
+	// - cs_ag - Chip select pin connected to the CS_AG pin.
+	// - cs_m - Chip select pin connected to the CS_M pin.
+	// - port - SPI port, defaults to SPI.
+	uint16_t begin_spi(uint8_t cs_ag, uint8_t cs_m);
+	uint16_t begin_spi(uint8_t cs_ag, uint8_t cs_m, SPIClass &port);
 
 	// Polls the accelerometer status register to check
 	// if new data is available.
@@ -61,6 +103,12 @@ public:
 	// - 1 - New data available
 	// - 0 - No new data available
 	uint8_t available_t();
+	// Polls the accel/gyro status register once and returns both
+	// data-ready flags (saves a bus transaction over available_a() + available_g()).
+	// ## Output
+	// - bit 0 (LSM9DS1_AVAILABLE_A) - New accel data available
+	// - bit 1 (LSM9DS1_AVAILABLE_G) - New gyro data available
+	uint8_t available_ag();
 	// Polls the accelerometer status register to check
 	// if new data is available.
 	// ## Input
@@ -77,26 +125,66 @@ public:
 	// ### The readings are stored in the class'
 	// - ax, ay, az 
 	// Read those after calling this function.
-	void read_a();
+	// ## Output
+	// - true - The readings were updated
+	// - false - The bus transfer failed and the readings are stale
+	bool read_a();
 	// Read the gyroscope output registers.
 	// This function will read all six gyroscope output registers.
 	// ### The readings are stored in the class'
 	// - gx, gy, gz
 	// Read those after calling this function.
-	void read_g();
+	// ## Output
+	// - true - The readings were updated
+	// - false - The bus transfer failed and the readings are stale
+	bool read_g();
 	// Read the temperature output register.
 	// This function will read two temperature output registers.
 	// ### The combined readings are stored in the class'
 	// - temperature
 	// Read those after calling this function.
-	void read_t();
+	// ## Output
+	// - true - The reading was updated
+	// - false - The bus transfer failed and the reading is stale
+	bool read_t();
 	// Read the magnetometer output registers.
 	// This function will read all six magnetometer output registers.
 	// ### The readings are stored in the class'
 	// - mx, my, mz
 	// Read those after calling this function.
-	void read_m();
+	// ## Output
+	// - true - The readings were updated
+	// - false - The bus transfer failed and the readings are stale
+	bool read_m();
+
+	// Recover a stuck bus and re-initialize the sensors.
+	// Clocks SCL up to 9 times until the slave releases SDA, issues a STOP,
+	// restarts the I2C port at its previous clock and writes the cached
+	// settings (and loaded mag offsets) back. Takes about 1 ms.
+	// On SPI only the re-initialization is done.
+	// Called automatically after LSM9DS1_RECOVER_ERRORS consecutive failed transfers
+	// (I2C) and by check() (both buses).
+	// ## Output
+	// - true - Both WHO_AM_I registers answered after recovery
+	bool recover();
+	// Check WHO_AM_I and write the cached settings (and loaded mag offsets) back
+	// (false if WHO_AM_I did not match or a transfer failed)
+	bool reinit();
+	// Sanity check of the sensor: WHO_AM_I of both dies, and on SPI the
+	// I2C_DISABLE bit that a power-on reset clears. A mismatch counts as a
+	// bus failure and runs recover() at once.
+	// An SPI transfer cannot fail (there is no ACK), so on SPI this is the
+	// only way a lost or reset sensor is noticed; call it periodically.
+	// ## Output
+	// - true - The sensor answered (after recovery if one was needed)
+	bool check();
 
+	// Convert from RAW signed 16-bit value to radians per second.
+	// This function reads in a signed 16-bit value and returns the scaled
+	// rate. This function relies on gScale and _res_g being correct.
+	// ## Input
+	//	- gyro = A signed 16-bit raw reading from the gyroscope.
+	float calc_g(int16_t gyro);
 	// Convert from RAW signed 16-bit value to gravity (g's).
 	// This function reads in a signed 16-bit value and returns the scaled
 	// g's. This function relies on aScale and _res_a being correct.
@@ -157,43 +245,14 @@ public:
 	void offset_m(uint8_t axis, int16_t offset);
 
 protected:
-	// Sets up gyro, accel, and mag settings to default.
-	// to set com interface and/or addresses see begin() and beginSPI().
+	// Copies the compile-time configuration (LSM9DS1_CONFIG, see lsm9ds1_config.h)
+	// into settings and the resolutions, and clears the biases.
 	void init();
-	// Sets up the accelerometer to begin reading.
-	// This function steps through all accelerometer related control registers.
-	// Upon exit these registers will be set as:
-	//	- CTRL_REG0_XM = 0x00: FIFO disabled. HPF bypassed. Normal mode.
-	//	- CTRL_REG1_XM = 0x57: 100 Hz data rate. Continuous update.
-	//		all axes enabled.
-	//	- CTRL_REG2_XM = 0x00:  2g scale. 773 Hz anti-alias filter BW.
-	//	- CTRL_REG3_XM = 0x04: Accel data ready signal on INT1_XM pin.
-	void init_a();
-	// Sets up the gyroscope to begin reading.
-	// This function steps through all five gyroscope control registers.
-	// Upon exit, the following parameters will be set:
-	//	- CTRL_REG1_G = 0x0F: Normal operation mode, all axes enabled. 
-	//		95 Hz ODR, 12.5 Hz cutoff frequency.
-	//	- CTRL_REG2_G = 0x00: HPF set to normal mode, cutoff frequency
-	//		set to 7.2 Hz (depends on ODR).
-	//	- CTRL_REG3_G = 0x88: Interrupt enabled on INT_G (set to push-pull and
-	//		active high). Data-ready output enabled on DRDY_G.
-	//	- CTRL_REG4_G = 0x00: Continuous update mode. Data LSB stored in lower
-	//		address. Scale set to 245 DPS. SPI mode set to 4-wire.
-	//	- CTRL_REG5_G = 0x00: FIFO disabled. HPF disabled.
-	void init_g();
-	// Sets up the magnetometer to begin reading.
-	// This function steps through all magnetometer-related control registers.
-	// Upon exit these registers will be set as:
-	//	- CTRL_REG4_XM = 0x04: Mag data ready signal on INT2_XM pin.
-	//	- CTRL_REG5_XM = 0x14: 100 Hz update rate. Low resolution. Interrupt
-	//		requests don't latch. Temperature sensor disabled.
-	//	- CTRL_REG6_XM = 0x00:  2 Gs scale.
-	//	- CTRL_REG7_XM = 0x00: Continuous conversion mode. Normal HPF mode.
-	//	- INT_CTRL_REG_M = 0x09: Interrupt active-high. Enable interrupts.
-	void init_m();
+	// Streams the precomputed control register bytes of LSM9DS1_CONFIG to the
+	// accel/gyro and the mag, and on SPI sets I2C_DISABLE of both dies.
+	// Returns false if a write failed.
+	bool write_image();
 
-	void constrain_scales();
 	// Calculate the resolution of the accelerometer.
 	// This function will set the value of the _res_a variable. aScale must
 	// be set prior to calling this function.
@@ -223,12 +282,16 @@ protected:
 	// ## Input
 	//	- addr_sub = Register to be written to.
 	//	- data = data to be written to the register.
-	void write_ag(uint8_t addr_sub, uint8_t data);
+	// ## Output
+	//	- false if the write failed (counted by bus_error()).
+	bool write_ag(uint8_t addr_sub, uint8_t data);
 	// Write a byte to a register in the gyroscope.
 	// ## Input
 	//	- addr_sub = Register to be written to.
 	//	- data = data to be written to the register.
-	void write_m(uint8_t addr_sub, uint8_t data);
+	// ## Output
+	//	- false if the write failed (counted by bus_error()).
+	bool write_m(uint8_t addr_sub, uint8_t data);
 	// Read a series of bytes, starting at a register
 	// ## Input
 	//	- address = The 7-bit I2C address of the slave _device.
@@ -239,6 +302,23 @@ protected:
 	//	 No value is returned by the function, but the registers read are
 	//	 all stored in the *dest array given.
 	uint8_t i2c_read_bytes(uint8_t address, uint8_t addr_sub, uint8_t * dest, uint8_t count);
+	// Read a series of bytes over SPI. address is the chip select pin.
+	uint8_t spi_read_bytes(uint8_t address, uint8_t addr_sub, uint8_t * dest, uint8_t count);
+	// Read a series of bytes over the selected transport (I2C or SPI)
+	uint8_t read_bytes(uint8_t address, uint8_t addr_sub, uint8_t * dest, uint8_t count);
+	// Write a byte over I2C (false and bus_error() when the slave does not ACK)
+	bool i2c_write_byte(uint8_t address, uint8_t addr_sub, uint8_t data);
+	// Write a byte over SPI. address is the chip select pin.
+	void spi_write_byte(uint8_t address, uint8_t addr_sub, uint8_t data);
+	// Write a byte over the selected transport (I2C or SPI)
+	bool write_byte(uint8_t address, uint8_t addr_sub, uint8_t data);
+	// Shared part of begin() and begin_spi()
+	uint16_t begin_common();
+	// Bus part of recover() on I2C (clock out the stuck slave and restart the port)
+	bool recover_i2c();
+	// Count a failed transfer (read or write) and recover the bus after
+	// LSM9DS1_RECOVER_ERRORS consecutive failures.
+	void bus_error();
 
 	// Enable or disable the FIFO
 	// ## Input
@@ -0,0 +1,101 @@
+#ifndef __LSM9DS1_CONFIG_H__
+#define __LSM9DS1_CONFIG_H__
+
+#include <stdint.h>
+
+// Compile-time sensor configuration.
+// A configuration is a struct of static constexpr fields like LSM9DS1_DEFAULT_CONFIG.
+// lsm9ds1.cpp checks it with static_assert (an invalid combination does not compile)
+// and folds it into the control register bytes, the IMU_SETTINGS copy and the
+// resolutions, so begin() only streams precomputed bytes to the sensor.
+// Define LSM9DS1_CONFIG (e.g. in build_flags) to use another configuration.
+struct LSM9DS1_DEFAULT_CONFIG {
+	static constexpr bool gyro_enabled = true;
+	static constexpr bool gyro_enable_x = true;
+	static constexpr bool gyro_enable_y = true;
+	static constexpr bool gyro_enable_z = true;
+	// gyro scale can be 245, 500, or 2000
+	static constexpr uint16_t gyro_scale = 245;
+	// gyro sample rate: value between 1-6
+	// 1 = 14.9    4 = 238
+	// 2 = 59.5    5 = 476
+	// 3 = 119     6 = 952
+	static constexpr uint8_t gyro_sample_rate = 6;
+	// gyro cutoff frequency: value between 0-3
+	// Actual value of cutoff frequency depends
+	// on sample rate.
+	static constexpr uint8_t gyro_bandwidth = 0;
+	// Low-power mode is only available up to 119 Hz (sample rate 1-3)
+	static constexpr bool gyro_lowpower_enable = false;
+	static constexpr bool gyro_hpf_enable = false;
+	// Gyro HPF cutoff frequency: value between 0-9
+	// Actual value depends on sample rate. Only applies
+	// if gyro_hpf_enable is true.
+	static constexpr uint8_t gyro_hpf_cutoff = 0;
+	static constexpr bool gyro_flip_x = false;
+	static constexpr bool gyro_flip_y = false;
+	static constexpr bool gyro_flip_z = false;
+	// Directional user orientation: value between 0-5
+	static constexpr uint8_t gyro_orientation = 0;
+	static constexpr bool gyro_latch_interrupt = true;
+
+	static constexpr bool accel_enabled = true;
+	static constexpr bool accel_enable_x = true;
+	static constexpr bool accel_enable_y = true;
+	static constexpr bool accel_enable_z = true;
+	// accel scale can be 2, 4, 8, or 16
+	static constexpr uint8_t accel_scale = 2;
+	// accel sample rate can be 1-6
+	// 1 = 10 Hz    4 = 238 Hz
+	// 2 = 50 Hz    5 = 476 Hz
+	// 3 = 119 Hz   6 = 952 Hz
+	// While the gyro is on both run at the gyro rate, so it must match gyro_sample_rate.
+	static constexpr uint8_t accel_sample_rate = 6;
+	// Accel cutoff freqeuncy can be any value between -1 - 3.
+	// -1 = bandwidth determined by sample rate
+	// 0 = 408 Hz   2 = 105 Hz
+	// 1 = 211 Hz   3 = 50 Hz
+	static constexpr int8_t accel_bandwidth = -1;
+	static constexpr bool accel_highres_enable = false;
+	// accel_highres_bandwidth can be any value between 0-3
+	// LP cutoff is set to a factor of sample rate
+	// 0 = ODR/50    2 = ODR/9
+	// 1 = ODR/100   3 = ODR/400
+	static constexpr uint8_t accel_highres_bandwidth = 0;
+
+	static constexpr bool mag_enabled = true;
+	// mag scale can be 4, 8, 12, or 16
+	static constexpr uint8_t mag_scale = 4;
+	// mag data rate can be 0-7
+	// 0 = 0.625 Hz  4 = 10 Hz
+	// 1 = 1.25 Hz   5 = 20 Hz
+	// 2 = 2.5 Hz    6 = 40 Hz
+	// 3 = 5 Hz      7 = 80 Hz
+	static constexpr uint8_t mag_sample_rate = 7;
+	static constexpr bool mag_temp_compensation_enable = false;
+	// mag performance can be any value between 0-3
+	// 0 = Low power mode      2 = high performance
+	// 1 = medium performance  3 = ultra-high performance
+	static constexpr uint8_t mag_xy_performance = 3;
+	static constexpr uint8_t mag_z_performance = 3;
+	static constexpr bool mag_lowpower_enable = false;
+	// mag operating mode can be 0-2
+	// 0 = continuous conversion
+	// 1 = single-conversion
+	// 2 = power down
+	static constexpr uint8_t mag_operating_mode = 0;
+
+	static constexpr bool temp_enabled = true;
+};
+
+#ifndef LSM9DS1_CONFIG
+#define LSM9DS1_CONFIG LSM9DS1_DEFAULT_CONFIG
+#endif
+
+// Gyro output data rate (Hz) of a sample rate setting (1-6, 0 = power down)
+constexpr float lsm9ds1_gyro_odr(uint8_t rate) {
+	return rate == 1 ? 14.9f : rate == 2 ? 59.5f : rate == 3 ? 119.0f :
+		rate == 4 ? 238.0f : rate == 5 ? 476.0f : rate == 6 ? 952.0f : 0.0f;
+}
+
+#endif /* __LSM9DS1_CONFIG_H__ */
@@ -0,0 +1,82 @@
+#include <math.h>
+#include "fusion.h"
+
+void MADGWICK::update(float q[4],
+	float wx, float wy, float wz,
+	float ax, float ay, float az,
+	float mx, float my, float mz,
+	float ka, float km,
+	float dt
+) {
+	const float qw = q[0], qx = q[1], qy = q[2], qz = q[3];
+	// 補正量(回転量(Δq)から引く補正勾配)
+	float dq[4] = { 0, 0, 0, 0 };
+	{
+		// X軸基準ベクトル
+		float xx, xy, xz;
+		xx = 2*(qw*qw + qx*qx) - 1;
+		xy = 2*(qx*qy - qw*qz);
+		xz = 2*(qx*qz + qw*qy);
+		// Y軸基準ベクトル
+		float yx, yy, yz;
+		yx = 2*(qx*qy + qw*qz);
+		yy = 2*(qw*qw + qy*qy) - 1;
+		yz = 2*(qy*qz - qw*qx);
+		// Z軸基準ベクトル
+		float zx, zy, zz;
+		zx = 2*(qx*qz - qw*qy);
+		zy = 2*(qy*qz + qw*qx);
+		zz = 2*(qw*qw + qz*qz) - 1;
+		// 補正勾配(grad s)＝鉛直方向の勾配(grad g)＋姿勢方位の勾配(grad h)
+		float sw = 0, sx = 0, sy = 0, sz = 0;
+		// 重みを付けた補正勾配
+		float kw = 0, kx = 0, ky = 0, kz = 0;
+		if (!(0 == ax && 0 == ay && 0 == az)) {
+			// 鉛直方向の変化(Δg)
+			float dgx, dgy, dgz;
+			dgx = zx - ax;
+			dgy = zy - ay;
+			dgz = zz - az;
+			// 鉛直方向の勾配(grad g)
+			sw += 2*(qx*dgy - qy*dgx);
+			sx += 2*(qw*dgy + qz*dgx - 2*qx*dgz);
+			sy += 2*(qz*dgy - qw*dgx - 2*qy*dgz);
+			sz += 2*(qy*dgy + qx*dgx);
+			kw = ka*sw, kx = ka*sx, ky = ka*sy, kz = ka*sz;
+		}
+		if (!(0 == mx && 0 == my && 0 == mz)) {
+			const float gw = sw, gx = sx, gy = sy, gz = sz;
+			// 姿勢方位(h)＝方位(m)を姿勢(q)で回転させた向き
+			float hx, hy, hz, hxy;
+			hx = xx*mx + xy*my + xz*mz;
+			hy = yx*mx + yy*my + yz*mz;
+			hz = zx*mx + zy*my + zz*mz;
+			hxy = sqrtf(hx*hx + hy*hy);
+			// 姿勢方位の変化(Δh)
+			float dhx, dhy, dhz;
+			dhx = xx*hxy + zx*hz - mx;
+			dhy = xy*hxy + zy*hz - my;
+			dhz = xz*hxy + zz*hz - mz;
+			// 姿勢方位の勾配(grad h)
+			sw += (qx*hz - qz*hxy)*dhy -             qy*hz *dhx +  qy*hxy           *dhz;
+			sx += (qw*hz + qy*hxy)*dhy +             qz*hz *dhx + (qz*hxy - 2*qx*hz)*dhz;
+			sy += (qz*hz + qx*hxy)*dhy - (2*qy*hxy + qw*hz)*dhx + (qw*hxy - 2*qy*hz)*dhz;
+			sz += (qy*hz - qw*hxy)*dhy - (2*qz*hxy - qx*hz)*dhx +  qx*hxy           *dhz;
+			kw += km*(sw - gw);
+			kx += km*(sx - gx);
+			ky += km*(sy - gy);
+			kz += km*(sz - gz);
+		}
+		float sr = sqrtf(sw*sw + sx*sx + sy*sy + sz*sz);
+		// 重みなしの補正勾配の大きさで正規化して補正係数(β)でスケーリング
+		if (sr > 0) {
+			sr = beta / sr;
+			dq[0] = -kw * sr;
+			dq[1] = -kx * sr;
+			dq[2] = -ky * sr;
+			dq[3] = -kz * sr;
+		}
+	}
+	// 回転量(Δq)＝姿勢(q)が角速度(w)で回転するときの時間変化に補正勾配を反映して積算
+	quat_integrate(q, wx, wy, wz, dq, dt);
+}
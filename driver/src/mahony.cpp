@@ -0,0 +1,62 @@
+#include <math.h>
+#include "fusion.h"
+
+void MAHONY::update(float q[4],
+	float wx, float wy, float wz,
+	float ax, float ay, float az,
+	float mx, float my, float mz,
+	float ka, float km,
+	float dt
+) {
+	const float qw = q[0], qx = q[1], qy = q[2], qz = q[3];
+	// X軸基準ベクトル
+	float xx, xy, xz;
+	xx = 2*(qw*qw + qx*qx) - 1;
+	xy = 2*(qx*qy - qw*qz);
+	xz = 2*(qx*qz + qw*qy);
+	// Z軸基準ベクトル(推定した鉛直方向)
+	float zx, zy, zz;
+	zx = 2*(qx*qz - qw*qy);
+	zy = 2*(qy*qz + qw*qx);
+	zz = 2*(qw*qw + qz*qz) - 1;
+	// 誤差(観測×推定)
+	float ex = 0, ey = 0, ez = 0;
+	if (!(0 == ax && 0 == ay && 0 == az)) {
+		ex += ka*(ay*zz - az*zy);
+		ey += ka*(az*zx - ax*zz);
+		ez += ka*(ax*zy - ay*zx);
+	}
+	if (!(0 == mx && 0 == my && 0 == mz)) {
+		// Y軸基準ベクトル
+		float yx, yy, yz;
+		yx = 2*(qx*qy + qw*qz);
+		yy = 2*(qw*qw + qy*qy) - 1;
+		yz = 2*(qy*qz - qw*qx);
+		// 姿勢方位(h)の水平成分を北に向けた基準をボディ座標に戻した向き(v)
+		float hx, hy, hz, hxy;
+		hx = xx*mx + xy*my + xz*mz;
+		hy = yx*mx + yy*my + yz*mz;
+		hz = zx*mx + zy*my + zz*mz;
+		hxy = sqrtf(hx*hx + hy*hy);
+		float vx, vy, vz;
+		vx = xx*hxy + zx*hz;
+		vy = xy*hxy + zy*hz;
+		vz = xz*hxy + zz*hz;
+		ex += km*(my*vz - mz*vy);
+		ey += km*(mz*vx - mx*vz);
+		ez += km*(mx*vy - my*vx);
+	}
+	// 積分項
+	if (ki > 0) {
+		ix += ki * ex * dt;
+		iy += ki * ey * dt;
+		iz += ki * ez * dt;
+	} else {
+		ix = 0, iy = 0, iz = 0;
+	}
+	// q' = -q⊗ω/2 なので補正は角速度から引く
+	wx -= kp*ex + ix;
+	wy -= kp*ey + iy;
+	wz -= kp*ez + iz;
+	quat_integrate(q, wx, wy, wz, nullptr, dt);
+}
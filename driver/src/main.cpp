@@ -1,13 +1,36 @@
 #include <Arduino.h>
 #include <Wire.h>
+#include <SPI.h>
 #include <WiFi.h>
+#include <WiFiUdp.h>
 
 #include "lsm9ds1.h"
+#include "lsm9ds1_config.h"
+#include "imu_reader.h"
 #include "imu_filter.h"
+#include "flight_control.h"
+#include "instrument.h"
+#include "telemetry.h"
+#include "decimator.h"
+#include "spectrum.h"
+#include "prefilter.h"
 
 #define LSM9DS1_M    0x1C // コンパスのI2Cアドレス
 #define LSM9DS1_AG   0x6A // 加速度とジャイロのI2Cアドレス
+// SPIで接続するときはチップセレクトのピンを定義する
+//#define LSM9DS1_CS_AG   5 // 加速度とジャイロのチップセレクト
+//#define LSM9DS1_CS_M   17 // コンパスのチップセレクト
+// I2Cのクロック(LSM9DS1の仕様は400kHzまで, それより速くするのは仕様外)
+#ifndef I2C_CLOCK
+#define I2C_CLOCK 400000
+#endif
+// I2Cのピン(バスの回復でも同じピンを使う)
+#ifndef I2C_SDA
+#define I2C_SDA SDA
+#define I2C_SCL SCL
+#endif
 #define SAMPLE_RATE   600 // サンプリング周波数
+static_assert(SAMPLE_RATE <= lsm9ds1_gyro_odr(LSM9DS1_CONFIG::gyro_sample_rate), "ジャイロの出力レートがサンプリング周波数より低い");
 
 const unsigned long DELTA_TIME = (int)1e+6 / SAMPLE_RATE;
 unsigned long micros_prev;
@@ -15,24 +38,80 @@ unsigned long micros_prev;
 const char *ssid = "auhikari-MzQmYz-g"; // アクセスポイントのSSID
 const char *pass = "UGNVmZwQWZzU3";     // アクセスポイントのパスワード
 const int port = 10002;                 // ESP32サーバのポート
-int wifi_interval = 10;                 // WIFI送受信間隔
-int wifi_interval_count = 0;
 WiFiServer server(port);
-WiFiClient client;
-bool connected = false;
+// 接続とコマンドを処理する間隔(周期)
+#define COMMAND_INTERVAL 10
+int command_count = 0;
+// 同時に接続できる数
+#define CLIENT_MAX 4
+WiFiClient clients[CLIENT_MAX];
+// 機体を知らせるUDPのポートと間隔(ms)
+#define ANNOUNCE_PORT     10001
+#define ANNOUNCE_INTERVAL 1000
+WiFiUDP udp;
+unsigned long announce_prev;
 
 // 9軸センサのインスタンス
 LSM9DS1 imu;
+// センサーの非同期読込み
+IMU_READER reader;
 IMU_FILTER filter;
+FLIGHT_CONTROL control;
+// 振動のスペクトル解析
+SPECTRUM spectrum;
+// 姿勢推定の前のジャイロのフィルタ
+GYRO_PREFILTER prefilter;
+// スペクトルのピークに合わせるノッチの数と, 最後に合わせた解析の回数
+int notch_auto = 0;
+uint32_t notch_frames = 0;
+// 送信するチャンネルと間引き
+TELEMETRY telemetry;
+// 間引いて送る値の折り返し防止(姿勢角の行の加速度, 加速度, ジャイロ)
+DECIMATOR angle_accel_decimator;
+DECIMATOR accel_decimator;
+DECIMATOR gyro_decimator;
+// ジャイロのゼロ点の計測("gcal"コマンド, 残りのサンプル数と合計)
+// 合計が桁あふれしないようサンプル数は5秒分までにする
+#define GYRO_CAL_MAX (5 * SAMPLE_RATE)
+int gyro_cal_count = 0;
+int gyro_cal_total = 0;
+int32_t gyro_cal_sum[3];
+// センサー読込み開始からモーター出力までの時間(us)
+unsigned long control_latency;
+// 続けて読込みに失敗した周期の数
+// IMU_DT_MAX周期以上途切れたら(バスの回復中など), 再開したサンプルは経過時間で積算しない
+int sample_lost = 0;
+
+// チャンネルを購読して, 間引きに合わせてフィルタを初期化する
+void subscribe(int channel, int decimation) {
+	telemetry.subscribe(channel, decimation);
+	decimation = telemetry.get_decimation(channel);
+	switch (channel) {
+	case TELEMETRY_ANGLE: angle_accel_decimator.reset(decimation); break;
+	case TELEMETRY_ACCEL: accel_decimator.reset(decimation); break;
+	case TELEMETRY_GYRO: gyro_decimator.reset(decimation); break;
+	case TELEMETRY_TEMP: reader.request_t(); break;
+	}
+}
 
 void setup() {
 	Serial.begin(115200);
 	Serial2.setRxInvert(true);
 	Serial2.begin(100000);
-	Wire.setClock(400000);
-	Wire.begin();
-	if (!imu.begin(LSM9DS1_AG, LSM9DS1_M, Wire)) {
-		while (1);
+#ifdef LSM9DS1_CS_AG
+	// センサーが応答しなければ再試行し, それでもだめなら再起動する
+	for (int retry = 0; !imu.begin_spi(LSM9DS1_CS_AG, LSM9DS1_CS_M, SPI); retry++) {
+#else
+	Wire.begin(I2C_SDA, I2C_SCL, I2C_CLOCK);
+	// センサーが応答しなければバスを回復して再試行し, それでもだめなら再起動する
+	for (int retry = 0; !imu.begin(LSM9DS1_AG, LSM9DS1_M, Wire, I2C_SDA, I2C_SCL); retry++) {
+#endif
+		Serial.println("imu not found");
+		if (retry >= 10) {
+			ESP.restart();
+		}
+		imu.recover();
+		delay(100);
 	}
 	// アクセスポイントに接続
 	WiFi.begin(ssid, pass);
@@ -47,84 +126,456 @@ void setup() {
 	Serial.println();
 	Serial.println(WiFi.localIP());
 	imu.calibrate_m();
+	// 起動直後は補正を強くして, 加速度と方位の乱れで重みを下げる
+	filter.set_ascale(imu.calc_a(1));
+	// ジャイロは生の値のまま渡して, 分解能と校正は姿勢推定の中でまとめて掛ける
+	filter.set_gres(imu.calc_g(1));
+	filter.set_adaptive(10.0f, 2.0f);
+	filter.set_sample_rate(SAMPLE_RATE);
+	prefilter.set_sample_rate(SAMPLE_RATE);
+	// 起動時の購読(間引きのフィルタも合わせて初期化する)
+	subscribe(TELEMETRY_ANGLE, TELEMETRY_DEFAULT_DECIMATION);
+	// 以降のセンサーの読込みは別のコアのタスクで行う
+	if (!reader.begin(imu, 0)) {
+		ESP.restart();
+	}
+	reader.start();
+	// スペクトル解析は読込みと同じコアの優先度の低いタスクで行う
+	if (!spectrum.begin(SAMPLE_RATE, 0)) {
+		ESP.restart();
+	}
 	micros_prev = micros();
 }
 
-void loop() {
-	if (!connected) {
-		client = server.available();
-		if (!client) {
-			delay(100);
-			return;
+// 受信したコマンド1行を実行する(応答はclientに返す)
+void command(WiFiClient &client, String &line) {
+	auto col = strtok((char*)line.c_str(), " ");
+	auto type = col;
+	if (type == nullptr) {
+		return;
+	}
+	if (0 == strcmp("wifi", type)) {
+		// 従来の送信間隔の指定は姿勢角の間引きにする
+		col = strtok(nullptr, " ");
+		if (col != nullptr) {
+			auto val = atoff(col);
+			if (val < 1) {
+				val = 1;
+			} else if (val > 100) {
+				val = 100;
+			}
+			subscribe(TELEMETRY_ANGLE, val);
+		}
+	}
+	if (0 == strcmp("sub", type)) {
+		// "sub <チャンネル> <間引き>" で購読(0でやめる), "sub" だけなら一覧を返す
+		auto name = strtok(nullptr, " ");
+		col = strtok(nullptr, " ");
+		if (name != nullptr && col != nullptr) {
+			int channel = TELEMETRY::find(name);
+			if (channel < 0) {
+				client.printf("#sub unknown %s\n", name);
+				return;
+			}
+			subscribe(channel, atoi(col));
+		}
+		char buf[128];
+		int n = telemetry.format(buf, sizeof(buf));
+		client.write((const uint8_t*)buf, n);
+	}
+	if (0 == strcmp("beta", type)) {
+		col = strtok(nullptr, " ");
+		if (col != nullptr) {
+			filter.set_gain(atoff(col));
+		}
+	}
+	if (0 == strcmp("stats", type)) {
+		// 計測値のスナップショット("stats reset"で0に戻す)
+#ifdef INSTRUMENT_ENABLE
+		col = strtok(nullptr, " ");
+		if (col != nullptr && 0 == strcmp("reset", col)) {
+			instrument.reset();
+		} else {
+			char stats[512];
+			int n = instrument.format(stats, sizeof(stats));
+			client.write((const uint8_t*)stats, n);
+		}
+#else
+		client.print("#stats disabled\n");
+#endif
+		client.printf("#i2c %u %u\n", (unsigned)imu.error_count, (unsigned)imu.recover_count);
+	}
+	if (0 == strcmp("fft", type)) {
+		// "fft <gx|gy|gz|ax|ay|az|off>" で解析する軸を変える, 状態を返す
+		col = strtok(nullptr, " ");
+		if (col != nullptr) {
+			int source = SPECTRUM::find(col);
+			if (source < SPECTRUM_SOURCE_COUNT) {
+				spectrum.set_source(source);
+			}
+		}
+		char buf[64];
+		int n = spectrum.format(buf, sizeof(buf));
+		client.write((const uint8_t*)buf, n);
+	}
+	if (0 == strcmp("lpf", type)) {
+		col = strtok(nullptr, " ");
+		if (col != nullptr) {
+			prefilter.set_lowpass(atoff(col));
+		}
+		char buf[96];
+		int n = prefilter.format(buf, sizeof(buf));
+		client.write((const uint8_t*)buf, n);
+	}
+	if (0 == strcmp("notch", type)) {
+		// "notch <番号> <周波数> [Q]" で設定(周波数0で無効)
+		// "notch auto <数>" でスペクトルのピークに追従させる(ジャイロを解析しているとき)
+		col = strtok(nullptr, " ");
+		if (col != nullptr && 0 == strcmp("auto", col)) {
+			col = strtok(nullptr, " ");
+			notch_auto = col != nullptr ? atoi(col) : 0;
+			if (notch_auto < 0) {
+				notch_auto = 0;
+			} else if (notch_auto > PREFILTER_NOTCH_MAX) {
+				notch_auto = PREFILTER_NOTCH_MAX;
+			}
+			if (notch_auto > SPECTRUM_PEAKS) {
+				notch_auto = SPECTRUM_PEAKS;
+			}
+		} else if (col != nullptr) {
+			int i = atoi(col);
+			float hz = 0, q = PREFILTER_NOTCH_Q;
+			col = strtok(nullptr, " ");
+			if (col != nullptr) {
+				hz = atoff(col);
+			}
+			col = strtok(nullptr, " ");
+			if (col != nullptr) {
+				q = atoff(col);
+			}
+			prefilter.set_notch(i, hz, q);
+		}
+		char buf[96];
+		int n = prefilter.format(buf, sizeof(buf));
+		client.write((const uint8_t*)buf, n);
+	}
+	if (0 == strcmp("adapt", type)) {
+		float gain = 0, tau = 2.0f;
+		col = strtok(nullptr, " ");
+		if (col != nullptr) {
+			gain = atoff(col);
+		}
+		col = strtok(nullptr, " ");
+		if (col != nullptr) {
+			tau = atoff(col);
+		}
+		filter.set_adaptive(gain, tau);
+	}
+	if (0 == strcmp("gscale", type)) {
+		col = strtok(nullptr, " ");
+		if (col != nullptr) {
+			filter.set_gscale(atoff(col));
+		}
+	}
+	if (0 == strcmp("gcal", type)) {
+		// "gcal [サンプル数]" 静止させた状態でジャイロのゼロ点を測る(既定は1秒分)
+		int count = SAMPLE_RATE;
+		col = strtok(nullptr, " ");
+		if (col != nullptr && atoi(col) > 0) {
+			count = atoi(col);
+		}
+		if (count > GYRO_CAL_MAX) {
+			count = GYRO_CAL_MAX;
+		}
+		gyro_cal_sum[0] = gyro_cal_sum[1] = gyro_cal_sum[2] = 0;
+		gyro_cal_total = count;
+		gyro_cal_count = count;
+	}
+	if (0 == strcmp("mscale", type)) {
+		col = strtok(nullptr, " ");
+		if (col != nullptr) {
+			filter.set_mscale(atoff(col));
+		}
+	}
+	if (0 == strcmp("p", type)) {
+		float x = 0, y = 0;
+		col = strtok(nullptr, " ");
+		if (col != nullptr) {
+			x = atoff(col);
+		}
+		col = strtok(nullptr, " ");
+		if (col != nullptr) {
+			y = atoff(col);
+		}
+		control.set_setpoint(x, y);
+	}
+	if (0 == strcmp("thr", type)) {
+		col = strtok(nullptr, " ");
+		if (col != nullptr) {
+			control.set_throttle(atoff(col));
+		}
+	}
+	if (0 == strcmp("angle", type)) {
+		col = strtok(nullptr, " ");
+		if (col != nullptr) {
+			control.set_angle_gain(atoff(col));
+		}
+	}
+	if (0 == strcmp("pid", type)) {
+		float gain[3] = { 0, 0, 0 };
+		for (int i = 0; i < 3; i++) {
+			col = strtok(nullptr, " ");
+			if (col == nullptr) {
+				break;
+			}
+			gain[i] = atoff(col);
+		}
+		control.set_rate_gain(gain[0], gain[1], gain[2]);
+	}
+}
+
+// 新しい接続を空いている枠に受け付ける
+void accept_clients() {
+	while (server.hasClient()) {
+		WiFiClient c = server.available();
+		bool accepted = false;
+		for (auto &client : clients) {
+			if (!client.connected()) {
+				client.stop();
+				client = c;
+				accepted = true;
+				Serial.println("new client");
+				break;
+			}
+		}
+		if (!accepted) {
+			c.stop();
 		}
-		Serial.println("new client");
-		connected = true;
 	}
-	if (micros() - micros_prev < DELTA_TIME) {
+}
+
+// 地上局が機体を見つけられるようにUDPのブロードキャストで知らせる
+void announce() {
+	unsigned long now = millis();
+	if (now - announce_prev < ANNOUNCE_INTERVAL) {
 		return;
 	}
-	imu.read_g();
-	imu.read_a();
-	imu.read_m();
-	filter.update(
-		imu.gx, imu.gy, imu.gz,
-		imu.ax, imu.ay, imu.az,
-		imu.mx, imu.my, imu.mz
-	);
-	if (++wifi_interval_count >= wifi_interval) {
-		wifi_interval_count = 0;
+	announce_prev = now;
+	char buf[32];
+	int len = snprintf(buf, sizeof(buf), "#vehicle %d\n", port);
+	udp.beginPacket(IPAddress(255, 255, 255, 255), ANNOUNCE_PORT);
+	udp.write((const uint8_t*)buf, len);
+	udp.endPacket();
+}
+
+// スペクトルの新しいピークにノッチを合わせる
+void track_notches() {
+	if (0 == notch_auto || spectrum.get_frames() == notch_frames) {
+		return;
+	}
+	notch_frames = spectrum.get_frames();
+	const int source = spectrum.get_source();
+	if (source < SPECTRUM_GX || source > SPECTRUM_GZ) {
+		return;
+	}
+	const SPECTRUM_PEAK *peaks = spectrum.get_peaks();
+	for (int i = 0; i < notch_auto; i++) {
+		// 見つからなかったピークと低すぎるピークでは動かさない
+		// Qはコマンドで設定した値のまま周波数だけ動かす
+		if (peaks[i].amplitude > 0 && peaks[i].hz >= PREFILTER_NOTCH_MIN) {
+			prefilter.set_notch(i, peaks[i].hz, prefilter.get_notch_q(i));
+		}
+	}
+}
+
+// bufの後ろに書き足す(入りきらなければ書き足さない)
+static int append(char *buf, int n, int size, const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	int len = vsnprintf(buf + n, size - n, format, args);
+	va_end(args);
+	if (len < 0 || n + len >= size) {
+		buf[n] = 0;
+		return n;
+	}
+	return n + len;
+}
+
+// 今回送るチャンネルだけを計算して文字列にする(戻り値は文字数)
+int encode_telemetry(char *buf, int size, const IMU_SAMPLE &s) {
+	int n = 0;
+	buf[0] = 0;
+	if (telemetry.is_due(TELEMETRY_ANGLE)) {
 		filter.compute_angles();
-		connected = client.connected();
-		if (connected) {
-			client.printf("%f,%f,%f,%d,%d,%d\n",
-				filter.roll, filter.pitch, filter.yaw,
-				imu.ax, imu.ay, imu.az
-			);
-			while (client.available()) {
+		float a[3];
+		angle_accel_decimator.pop(a);
+		n = append(buf, n, size, "%f,%f,%f,%d,%d,%d\n",
+			filter.roll, filter.pitch, filter.yaw,
+			(int)lroundf(a[0]), (int)lroundf(a[1]), (int)lroundf(a[2])
+		);
+	}
+	if (telemetry.is_due(TELEMETRY_QUAT)) {
+		float q[4];
+		filter.get_quaternion(q);
+		n = append(buf, n, size, "#q %f,%f,%f,%f\n", q[0], q[1], q[2], q[3]);
+	}
+	if (telemetry.is_due(TELEMETRY_GYRO)) {
+		float g[3], w[3];
+		gyro_decimator.pop(g);
+		filter.calibrate_rate(g, w);
+		n = append(buf, n, size, "#g %f,%f,%f\n", w[0], w[1], w[2]);
+	}
+	if (telemetry.is_due(TELEMETRY_ACCEL)) {
+		float a[3];
+		accel_decimator.pop(a);
+		n = append(buf, n, size, "#a %d,%d,%d\n", (int)lroundf(a[0]), (int)lroundf(a[1]), (int)lroundf(a[2]));
+	}
+	if (telemetry.is_due(TELEMETRY_MAG)) {
+		n = append(buf, n, size, "#m %d,%d,%d\n", s.mx, s.my, s.mz);
+	}
+	if (telemetry.is_due(TELEMETRY_TEMP)) {
+		// 送った後に読み込みを頼むので, 値は1つ前の送信周期のもの
+		n = append(buf, n, size, "#t %d\n", s.temperature);
+		reader.request_t();
+	}
+	if (telemetry.is_due(TELEMETRY_LOOP)) {
+		n = append(buf, n, size, "#l %lu,%lu,%lu\n",
+			(unsigned long)(filter.get_dt() * 1e+6f), control_latency, filter.get_dt_anomaly()
+		);
+	}
+	if (telemetry.is_due(TELEMETRY_MOTOR)) {
+		n = append(buf, n, size, "#o %f,%f,%f,%f,%f\n",
+			control.throttle,
+			control.motor[0], control.motor[1], control.motor[2], control.motor[3]
+		);
+	}
+	if (telemetry.is_due(TELEMETRY_SPECTRUM)) {
+		const SPECTRUM_PEAK *peaks = spectrum.get_peaks();
+		n = append(buf, n, size, "#f");
+		for (int i = 0; i < SPECTRUM_PEAKS; i++) {
+			n = append(buf, n, size, "%s%.1f,%f", 0 == i ? " " : ",", peaks[i].hz, peaks[i].amplitude);
+		}
+		n = append(buf, n, size, "\n");
+	}
+	return n;
+}
+
+// 読み込んだ1回分のデータで姿勢推定, 制御, 解析, テレメトリ送信を行う
+void process_sample(const IMU_SAMPLE &s) {
+	float ax = 0, ay = 0, az = 0;
+	if (s.valid_a) {
+		ax = s.ax, ay = s.ay, az = s.az;
+	}
+	float mx = 0, my = 0, mz = 0;
+	if (s.valid_m) {
+		mx = s.mx, my = s.my, mz = s.mz;
+	}
+	// 静止させてジャイロのゼロ点を測る
+	if (gyro_cal_count > 0) {
+		gyro_cal_sum[0] += s.gx;
+		gyro_cal_sum[1] += s.gy;
+		gyro_cal_sum[2] += s.gz;
+		if (0 == --gyro_cal_count) {
+			float offset[3];
+			for (int i = 0; i < 3; i++) {
+				offset[i] = (float)gyro_cal_sum[i] / gyro_cal_total;
+			}
+			filter.set_gyro_offset(offset);
+		}
+	}
+	// 姿勢推定と制御にはフィルタを通したジャイロを使う(スペクトル解析には元の値)
+	// フィルタは生の値の単位のまま通す(ゼロ点と分解能は姿勢推定の中で扱う)
+	float gx = s.gx, gy = s.gy, gz = s.gz;
+	prefilter.update(gx, gy, gz);
+	// ジャイロを読み込んだ時刻の差で積算する
+	filter.update_micros(
+		gx, gy, gz,
+		ax, ay, az,
+		mx, my, mz,
+		s.time
+	);
+	INSTRUMENT_STAGE_END(INSTRUMENT_FILTER);
+	float q_heading[4], q_target[4], q_error[4];
+	filter.get_heading(q_heading);
+	control.compute_target(q_heading, q_target);
+	filter.compute_error(q_target, q_error);
+	// 姿勢推定で校正した角速度(rad/s)で制御する
+	float w[3];
+	filter.get_rate(w);
+	control.update(
+		q_error,
+		w[0], w[1], w[2],
+		filter.get_dt()
+	);
+	control_latency = micros() - s.time;
+	INSTRUMENT_STAGE_END(INSTRUMENT_CONTROL);
+	spectrum.push(s);
+	track_notches();
+	// 間引いて送るチャンネルは全てのサンプルをフィルタに通す
+	if (0 != telemetry.get_decimation(TELEMETRY_ANGLE)) {
+		angle_accel_decimator.push(s.ax, s.ay, s.az);
+	}
+	if (0 != telemetry.get_decimation(TELEMETRY_ACCEL)) {
+		accel_decimator.push(s.ax, s.ay, s.az);
+	}
+	if (0 != telemetry.get_decimation(TELEMETRY_GYRO)) {
+		gyro_decimator.push(s.gx, s.gy, s.gz);
+	}
+	INSTRUMENT_STAGE_END(INSTRUMENT_ANALYSIS);
+	if (telemetry.tick()) {
+		// 購読しているものだけを1回だけ文字列にして全ての接続に同じものを送る
+		char buf[512];
+		int len = encode_telemetry(buf, sizeof(buf), s);
+		for (auto &client : clients) {
+			if (client.connected()) {
+				int sent = client.write((const uint8_t*)buf, len);
+				INSTRUMENT_TX(sent, len);
+			}
+		}
+		INSTRUMENT_STAGE_END(INSTRUMENT_TELEMETRY);
+	}
+}
+
+void loop() {
+	unsigned long micros_now = micros();
+	if (micros_now - micros_prev < DELTA_TIME) {
+		return;
+	}
+	INSTRUMENT_MARK();
+	// 前回開始した読込みを受け取り, 次の読込みを開始する
+	// 読込みの間に受け取ったデータで姿勢推定と制御を行う
+	IMU_SAMPLE s;
+	// 新しいデータを待って遅れた読込みも受け取る(遅れた分は次の周期で合わせ直す)
+	bool collected = reader.collect(s, IMU_READER_TIMEOUT);
+	reader.start();
+	// 処理時間によらず一定の周期で実行する(遅れすぎたら合わせ直す)
+	micros_prev += DELTA_TIME;
+	if (micros_now - micros_prev >= DELTA_TIME) {
+		micros_prev = micros_now;
+		INSTRUMENT_MISSED();
+	}
+	INSTRUMENT_TICK(micros_now, DELTA_TIME);
+	// 読込みの完了を待った時間
+	INSTRUMENT_STAGE_END(INSTRUMENT_WAIT);
+	// 読込みに失敗したデータは使わない
+	// (ジャイロは次の周期で読み直して経過時間で積算, 加速度と方位は0ベクトルで補正しない)
+	// コマンドの受付は読込みに失敗しても続ける
+	if (collected && s.valid_g) {
+		sample_lost = 0;
+		process_sample(s);
+	} else if (++sample_lost >= IMU_DT_MAX) {
+		filter.reset_time();
+	}
+	if (++command_count >= COMMAND_INTERVAL) {
+		command_count = 0;
+		accept_clients();
+		for (auto &client : clients) {
+			while (client.connected() && client.available()) {
 				auto line = client.readStringUntil('\n');
-				auto col = strtok((char*)line.c_str(), " ");
-				auto type = col;
-				if (0 == strcmp("wifi", type)) {
-					col = strtok(nullptr, " ");
-					if (col != nullptr) {
-						auto val = atoff(col);
-						if (val < 1) {
-							wifi_interval = 1;
-						} else if (val > 100) {
-							wifi_interval = 100;
-						} else {
-							wifi_interval = val;
-						}
-					}
-				}
-				if (0 == strcmp("beta", type)) {
-					col = strtok(nullptr, " ");
-					if (col != nullptr) {
-						filter.set_beta(atoff(col));
-					}
-				}
-				if (0 == strcmp("gscale", type)) {
-					col = strtok(nullptr, " ");
-					if (col != nullptr) {
-						filter.set_gscale(atoff(col));
-					}
-				}
-				if (0 == strcmp("mscale", type)) {
-					col = strtok(nullptr, " ");
-					if (col != nullptr) {
-						filter.set_mscale(atoff(col));
-					}
-				}
-				if (0 == strcmp("p", type)) {
-					col = strtok(nullptr, " ");
-					if (col != nullptr) {
-					}
-					col = strtok(nullptr, " ");
-					if (col != nullptr) {
-					}
-				}
+				command(client, line);
 			}
 		}
+		INSTRUMENT_STAGE_END(INSTRUMENT_COMMAND);
+		announce();
 	}
-	micros_prev = micros();
 }
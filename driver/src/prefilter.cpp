@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <math.h>
+#include "prefilter.h"
+
+// 低域通過のQ(2次バターワース)
+#define PREFILTER_LOWPASS_Q 0.70710678f
+
+GYRO_PREFILTER::GYRO_PREFILTER() {
+	sample_rate = 1;
+	for (int i = 0; i < PREFILTER_STAGES; i++) {
+		hz[i] = 0;
+		q[i] = PREFILTER_NOTCH_Q;
+		b0[i] = 1;
+		b1[i] = 0;
+		b2[i] = 0;
+		a1[i] = 0;
+		a2[i] = 0;
+	}
+	q[0] = PREFILTER_LOWPASS_Q;
+	enabled = 0;
+	reset();
+}
+
+void GYRO_PREFILTER::set_sample_rate(float sample_rate) {
+	this->sample_rate = sample_rate;
+	for (int i = 0; i < PREFILTER_STAGES; i++) {
+		compute(i);
+	}
+}
+
+void GYRO_PREFILTER::set_lowpass(float hz) {
+	this->hz[0] = hz;
+	compute(0);
+}
+
+void GYRO_PREFILTER::set_notch(int i, float hz, float q) {
+	if (i < 0 || i >= PREFILTER_NOTCH_MAX) {
+		return;
+	}
+	this->hz[1 + i] = hz;
+	this->q[1 + i] = q > 0 ? q : PREFILTER_NOTCH_Q;
+	compute(1 + i);
+}
+
+void GYRO_PREFILTER::reset() {
+	for (int i = 0; i < PREFILTER_STAGES; i++) {
+		for (int k = 0; k < 4; k++) {
+			z1[i][k] = 0;
+			z2[i][k] = 0;
+			last[i][k] = 0;
+		}
+	}
+}
+
+// RBJの双2次フィルタの係数を求める(ナイキスト周波数以上は無効にする)
+void GYRO_PREFILTER::compute(int stage) {
+	const unsigned bit = 1u << stage;
+	if (hz[stage] <= 0 || hz[stage] >= 0.5f * sample_rate) {
+		if (enabled & bit) {
+			enabled &= ~bit;
+			z1[stage][0] = z1[stage][1] = z1[stage][2] = 0;
+			z2[stage][0] = z2[stage][1] = z2[stage][2] = 0;
+		}
+		return;
+	}
+	const float w = 2 * (float)M_PI * hz[stage] / sample_rate;
+	const float cs = cosf(w);
+	const float alpha = sinf(w) / (2 * q[stage]);
+	const float a0 = 1 + alpha;
+	if (0 == stage) {
+		b0[stage] = 0.5f * (1 - cs) / a0;
+		b1[stage] = (1 - cs) / a0;
+		b2[stage] = b0[stage];
+	} else {
+		b0[stage] = 1 / a0;
+		b1[stage] = -2 * cs / a0;
+		b2[stage] = b0[stage];
+	}
+	a1[stage] = -2 * cs / a0;
+	a2[stage] = (1 - alpha) / a0;
+	// 0の状態から始めると入力の直流分で出力が跳ぶ
+	if (!(enabled & bit)) {
+		prime(stage);
+	}
+	enabled |= bit;
+}
+
+// 入力xが続くと出力は直流の利得H(1) = (b0 + b1 + b2) / (1 + a1 + a2)倍のyになり,
+// 直接形II転置の状態はs1 = y - b0 x, s2 = b2 x - a2 yになる
+void GYRO_PREFILTER::prime(int stage) {
+	const float gain = (b0[stage] + b1[stage] + b2[stage]) / (1 + a1[stage] + a2[stage]);
+	for (int k = 0; k < 3; k++) {
+		const float in = last[stage][k];
+		const float out = gain * in;
+		z1[stage][k] = out - b0[stage] * in;
+		z2[stage][k] = b2[stage] * in - a2[stage] * out;
+	}
+}
+
+void GYRO_PREFILTER::update(float &x, float &y, float &z) {
+	float v[3] = { x, y, z };
+	for (int i = 0; i < PREFILTER_STAGES; i++) {
+		last[i][0] = v[0], last[i][1] = v[1], last[i][2] = v[2];
+		if (!(enabled & (1u << i))) {
+			continue;
+		}
+		const float c0 = b0[i], c1 = b1[i], c2 = b2[i], d1 = a1[i], d2 = a2[i];
+		float *s1 = z1[i];
+		float *s2 = z2[i];
+		for (int k = 0; k < 3; k++) {
+			const float in = v[k];
+			const float out = c0 * in + s1[k];
+			s1[k] = c1 * in - d1 * out + s2[k];
+			s2[k] = c2 * in - d2 * out;
+			v[k] = out;
+		}
+	}
+	x = v[0], y = v[1], z = v[2];
+}
+
+int GYRO_PREFILTER::format(char *buf, int size) const {
+	int n = snprintf(buf, size, "#prefilter lpf %.1f notch", hz[0]);
+	for (int i = 1; i < PREFILTER_STAGES && n < size; i++) {
+		n += snprintf(buf + n, size - n, " %.1f", hz[i]);
+	}
+	if (n < size) {
+		n += snprintf(buf + n, size - n, "\n");
+	}
+	return n < size ? n : size - 1;
+}
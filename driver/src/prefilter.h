@@ -0,0 +1,67 @@
+#ifndef __PREFILTER_H__
+#define __PREFILTER_H__
+
+// ノッチの最大数
+#define PREFILTER_NOTCH_MAX   4
+// 段の数(0段目が低域通過, 1段目以降がノッチ)
+#define PREFILTER_STAGES      (1 + PREFILTER_NOTCH_MAX)
+// ノッチの既定のQ
+#define PREFILTER_NOTCH_Q     3.0f
+// 追従させるノッチの周波数の下限(Hz, これより低いピークは機体の動きとみなす)
+#define PREFILTER_NOTCH_MIN   40.0f
+
+// 姿勢推定の前のジャイロのフィルタ(双2次の低域通過と複数のノッチ)
+// 係数は段ごとに3軸で共通, 状態は段ごとに3軸を並べて持ち(SoA), 1段ずつ3軸まとめて処理する
+// 周波数0の段は処理しない
+class GYRO_PREFILTER {
+private:
+	float sample_rate;
+	// 段ごとの係数(直接形II転置, a0=1で正規化)
+	float b0[PREFILTER_STAGES];
+	float b1[PREFILTER_STAGES];
+	float b2[PREFILTER_STAGES];
+	float a1[PREFILTER_STAGES];
+	float a2[PREFILTER_STAGES];
+	// 段ごとの3軸の状態(4つ目は詰め物)
+	float z1[PREFILTER_STAGES][4];
+	float z2[PREFILTER_STAGES][4];
+	// 段ごとの3軸の直前の入力(段を有効にしたときに状態を合わせる)
+	float last[PREFILTER_STAGES][4];
+	// 段ごとの周波数(Hz, 0は無効)とQ
+	float hz[PREFILTER_STAGES];
+	float q[PREFILTER_STAGES];
+	// 有効な段のビット
+	unsigned enabled;
+
+public:
+	GYRO_PREFILTER();
+	void set_sample_rate(float sample_rate);
+	// 低域通過の遮断周波数(Hz, 0で無効)
+	void set_lowpass(float hz);
+	// i番目のノッチの中心周波数(Hz, 0で無効)とQ
+	// 状態は残すので, 動かしながら使っても出力は跳ばない
+	// 無効から有効にした段は直前の入力が続いていた状態から始める
+	void set_notch(int i, float hz, float q = PREFILTER_NOTCH_Q);
+	float get_lowpass() const {
+		return hz[0];
+	}
+	float get_notch(int i) const {
+		return hz[1 + i];
+	}
+	float get_notch_q(int i) const {
+		return q[1 + i];
+	}
+	// 状態を0に戻す
+	void reset();
+	// 3軸をまとめて通す
+	void update(float &x, float &y, float &z);
+	// 設定を "#prefilter lpf 周波数 notch 周波数 ..." の1行にする(戻り値は書き込んだ文字数)
+	int format(char *buf, int size) const;
+
+private:
+	void compute(int stage);
+	// 直前の入力が続いていたときの定常状態にする
+	void prime(int stage);
+};
+
+#endif /* __PREFILTER_H__ */
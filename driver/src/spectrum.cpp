@@ -0,0 +1,241 @@
+#include <Arduino.h>
+#include <math.h>
+#include <string.h>
+#include "spectrum.h"
+
+// SPECTRUM_SIZE点の回転因子 W^k = cos(2πk/N) - i sin(2πk/N) とハン窓
+static float twiddle_cos[SPECTRUM_SIZE];
+static float twiddle_sin[SPECTRUM_SIZE];
+static float window[SPECTRUM_SIZE];
+
+static const char *const SPECTRUM_NAME[SPECTRUM_SOURCE_COUNT] = {
+	"gx", "gy", "gz", "ax", "ay", "az"
+};
+
+void fft_init() {
+	for (int k = 0; k < SPECTRUM_SIZE; k++) {
+		float t = 2 * (float)M_PI * k / SPECTRUM_SIZE;
+		twiddle_cos[k] = cosf(t);
+		twiddle_sin[k] = sinf(t);
+		window[k] = 0.5f - 0.5f * cosf(t);
+	}
+}
+
+void fft_radix4(float *re, float *im, int n) {
+	const int stride = SPECTRUM_SIZE / n;
+	// 周波数間引き: 長さlenの区間ごとに4つに分けたバタフライと回転
+	for (int len = n; len >= 4; len >>= 2) {
+		const int q = len >> 2;
+		const int step = stride * (n / len);
+		for (int j = 0; j < q; j++) {
+			const int t1 = j * step, t2 = 2 * t1, t3 = 3 * t1;
+			const float w1r = twiddle_cos[t1], w1i = -twiddle_sin[t1];
+			const float w2r = twiddle_cos[t2], w2i = -twiddle_sin[t2];
+			const float w3r = twiddle_cos[t3], w3i = -twiddle_sin[t3];
+			for (int k = j; k < n; k += len) {
+				const int k1 = k + q, k2 = k1 + q, k3 = k2 + q;
+				const float s0r = re[k] + re[k2], s0i = im[k] + im[k2];
+				const float d0r = re[k] - re[k2], d0i = im[k] - im[k2];
+				const float s1r = re[k1] + re[k3], s1i = im[k1] + im[k3];
+				// -i(a1 - a3)
+				const float d1r = im[k1] - im[k3], d1i = re[k3] - re[k1];
+				re[k] = s0r + s1r;
+				im[k] = s0i + s1i;
+				float xr = d0r + d1r, xi = d0i + d1i;
+				re[k1] = xr * w1r - xi * w1i;
+				im[k1] = xr * w1i + xi * w1r;
+				xr = s0r - s1r, xi = s0i - s1i;
+				re[k2] = xr * w2r - xi * w2i;
+				im[k2] = xr * w2i + xi * w2r;
+				xr = d0r - d1r, xi = d0i - d1i;
+				re[k3] = xr * w3r - xi * w3i;
+				im[k3] = xr * w3i + xi * w3r;
+			}
+		}
+	}
+}
+
+void fft_digit_reverse(float *re, float *im, int n) {
+	for (int i = 0; i < n; i++) {
+		int r = 0;
+		for (int m = 1, x = i; m < n; m <<= 2, x >>= 2) {
+			r = (r << 2) | (x & 3);
+		}
+		if (r > i) {
+			float t = re[i];
+			re[i] = re[r];
+			re[r] = t;
+			t = im[i];
+			im[i] = im[r];
+			im[r] = t;
+		}
+	}
+}
+
+void fft_real_power(const float *x, float *re, float *im, float *power) {
+	// 偶数番目を実部, 奇数番目を虚部にして半分の点数の複素FFTを行う
+	const int m = SPECTRUM_HALF;
+	for (int k = 0; k < m; k++) {
+		re[k] = x[2 * k];
+		im[k] = x[2 * k + 1];
+	}
+	fft_radix4(re, im, m);
+	fft_digit_reverse(re, im, m);
+	// Z[k]とZ[m-k]の共役から偶数番目と奇数番目のスペクトルに分けて合成する
+	for (int k = 0; k < m; k++) {
+		const int j = (m - k) & (m - 1);
+		const float zr = re[k], zi = im[k];
+		const float cr = re[j], ci = -im[j];
+		const float er = 0.5f * (zr + cr), ei = 0.5f * (zi + ci);
+		const float or_ = 0.5f * (zi - ci), oi = -0.5f * (zr - cr);
+		const float wr = twiddle_cos[k], wi = -twiddle_sin[k];
+		const float xr = er + wr * or_ - wi * oi;
+		const float xi = ei + wr * oi + wi * or_;
+		power[k] = xr * xr + xi * xi;
+	}
+}
+
+SPECTRUM::SPECTRUM() {
+	task = nullptr;
+	sample_rate = 1;
+	source = SPECTRUM_OFF;
+	ring_pos = 0;
+	ring_count = 0;
+	hop = 0;
+	busy = false;
+	memset(peaks, 0, sizeof(peaks));
+	ready = 0;
+	cycles = 0;
+	frames = 0;
+	skipped = 0;
+}
+
+bool SPECTRUM::begin(float sample_rate, int core) {
+	this->sample_rate = sample_rate;
+	fft_init();
+	return pdPASS == xTaskCreatePinnedToCore(task_entry, "spectrum", 4096, this, 1, &task, core);
+}
+
+int SPECTRUM::find(const char *name) {
+	if (0 == strcmp("off", name)) {
+		return SPECTRUM_OFF;
+	}
+	for (int i = 0; i < SPECTRUM_SOURCE_COUNT; i++) {
+		if (0 == strcmp(SPECTRUM_NAME[i], name)) {
+			return i;
+		}
+	}
+	return SPECTRUM_SOURCE_COUNT;
+}
+
+const char *SPECTRUM::name(int source) {
+	return 0 <= source && source < SPECTRUM_SOURCE_COUNT ? SPECTRUM_NAME[source] : "off";
+}
+
+void SPECTRUM::set_source(int source) {
+	this->source = source;
+	ring_pos = 0;
+	ring_count = 0;
+	hop = 0;
+}
+
+void SPECTRUM::push(const IMU_SAMPLE &s) {
+	float v;
+	switch (source) {
+	case SPECTRUM_GX: v = s.gx; break;
+	case SPECTRUM_GY: v = s.gy; break;
+	case SPECTRUM_GZ: v = s.gz; break;
+	case SPECTRUM_AX: v = s.ax; break;
+	case SPECTRUM_AY: v = s.ay; break;
+	case SPECTRUM_AZ: v = s.az; break;
+	default: return;
+	}
+	ring[ring_pos] = v;
+	ring_pos = (ring_pos + 1) & (SPECTRUM_SIZE - 1);
+	if (ring_count < SPECTRUM_SIZE) {
+		ring_count++;
+	}
+	// 半分ずつ重ねて解析する
+	if (++hop < SPECTRUM_HALF || ring_count < SPECTRUM_SIZE) {
+		return;
+	}
+	hop = 0;
+	if (busy || nullptr == task) {
+		skipped++;
+		return;
+	}
+	// 古い順に並べて渡す
+	const int tail = SPECTRUM_SIZE - ring_pos;
+	memcpy(input, ring + ring_pos, tail * sizeof(float));
+	memcpy(input + tail, ring, ring_pos * sizeof(float));
+	busy = true;
+	xTaskNotifyGive(task);
+}
+
+int SPECTRUM::format(char *buf, int size) const {
+	return snprintf(buf, size, "#fft %s %u %u %u\n",
+		name(source), (unsigned)frames, (unsigned)skipped, (unsigned)cycles
+	);
+}
+
+void SPECTRUM::task_entry(void *arg) {
+	auto self = (SPECTRUM*)arg;
+	while (1) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		self->analyze();
+		self->busy = false;
+	}
+}
+
+void SPECTRUM::analyze() {
+	uint32_t begin = ESP.getCycleCount();
+	// 平均を引いて窓をかける
+	float mean = 0;
+	for (int i = 0; i < SPECTRUM_SIZE; i++) {
+		mean += input[i];
+	}
+	mean /= SPECTRUM_SIZE;
+	for (int i = 0; i < SPECTRUM_SIZE; i++) {
+		input[i] = (input[i] - mean) * window[i];
+	}
+	fft_real_power(input, re, im, power);
+	// 極大の区間を大きい順にSPECTRUM_PEAKS個選ぶ(直流付近の2区間は除く)
+	SPECTRUM_PEAK *out = peaks[1 - ready];
+	float top[SPECTRUM_PEAKS];
+	int bin[SPECTRUM_PEAKS];
+	for (int i = 0; i < SPECTRUM_PEAKS; i++) {
+		top[i] = 0;
+		bin[i] = 0;
+	}
+	for (int k = 2; k < SPECTRUM_HALF - 1; k++) {
+		const float p = power[k];
+		if (p <= power[k - 1] || p < power[k + 1] || p <= top[SPECTRUM_PEAKS - 1]) {
+			continue;
+		}
+		int i = SPECTRUM_PEAKS - 1;
+		for (; i > 0 && p > top[i - 1]; i--) {
+			top[i] = top[i - 1];
+			bin[i] = bin[i - 1];
+		}
+		top[i] = p;
+		bin[i] = k;
+	}
+	// 振幅はハン窓の利得(N/2)で割って片側にするので 2|X|/(N/2)
+	const float amplitude_scale = 4.0f / SPECTRUM_SIZE;
+	for (int i = 0; i < SPECTRUM_PEAKS; i++) {
+		const int k = bin[i];
+		if (0 == k) {
+			out[i].hz = 0;
+			out[i].amplitude = 0;
+			continue;
+		}
+		const float a = sqrtf(power[k - 1]), b = sqrtf(power[k]), c = sqrtf(power[k + 1]);
+		const float d = a - 2 * b + c;
+		const float offset = d < 0 ? 0.5f * (a - c) / d : 0;
+		out[i].hz = (k + offset) * sample_rate / SPECTRUM_SIZE;
+		out[i].amplitude = b * amplitude_scale;
+	}
+	ready = 1 - ready;
+	cycles = ESP.getCycleCount() - begin;
+	frames++;
+}
@@ -0,0 +1,95 @@
+#ifndef __SPECTRUM_H__
+#define __SPECTRUM_H__
+
+#include <Arduino.h>
+#include "imu_reader.h"
+
+// FFTの点数(実数), 内部では半分の点数の複素FFT(基数4)を使うので4^k*2にすること
+#define SPECTRUM_SIZE  512
+#define SPECTRUM_HALF  (SPECTRUM_SIZE / 2)
+// 送るピークの数
+#define SPECTRUM_PEAKS 3
+
+// 解析する軸
+enum SPECTRUM_SOURCE {
+	SPECTRUM_OFF = -1,
+	SPECTRUM_GX, SPECTRUM_GY, SPECTRUM_GZ, // ジャイロ(生の値)
+	SPECTRUM_AX, SPECTRUM_AY, SPECTRUM_AZ, // 加速度(生の値)
+	SPECTRUM_SOURCE_COUNT
+};
+
+// スペクトルのピーク
+struct SPECTRUM_PEAK {
+	float hz;        // 周波数(Hz, 隣の区間との放物線補間)
+	float amplitude; // 振幅(入力と同じ単位)
+};
+
+// 振動のスペクトル解析
+// 制御ループがpush()で1軸の値を溜め, SPECTRUM_HALFサンプルごとに直前SPECTRUM_SIZEサンプルを
+// 優先度の低いタスクに渡してハン窓をかけたFFTを行い, 大きい順にピークを求める
+// タスクが前の解析を終えていなければその回は飛ばす
+class SPECTRUM {
+private:
+	TaskHandle_t task;
+	float sample_rate;
+	int source;
+	// 制御ループ側のリングバッファ
+	float ring[SPECTRUM_SIZE];
+	int ring_pos;
+	int ring_count;
+	int hop;
+	// 解析タスク側
+	float input[SPECTRUM_SIZE];
+	float re[SPECTRUM_HALF];
+	float im[SPECTRUM_HALF];
+	float power[SPECTRUM_HALF];
+	volatile bool busy;
+	// 結果(タスクが書いていない方を読む)
+	SPECTRUM_PEAK peaks[2][SPECTRUM_PEAKS];
+	volatile int ready;
+	// 1回の解析のCPUサイクル数と回数
+	volatile uint32_t cycles;
+	volatile uint32_t frames;
+	uint32_t skipped;
+
+public:
+	SPECTRUM();
+	// 解析用のタスクをcoreで開始する(優先度は最低)
+	bool begin(float sample_rate, int core);
+	static int find(const char *name);
+	static const char *name(int source);
+	// 解析する軸を変える(SPECTRUM_OFFで止める)
+	void set_source(int source);
+	int get_source() const {
+		return source;
+	}
+	// 1サンプル分を溜め, 溜まったら解析を始める
+	void push(const IMU_SAMPLE &s);
+	// 最新のピーク(大きい順, 見つからなければ振幅0)
+	const SPECTRUM_PEAK *get_peaks() const {
+		return peaks[ready];
+	}
+	// 解析した回数(新しい結果が出たかを調べる)
+	uint32_t get_frames() const {
+		return frames;
+	}
+	// 状態を "#fft 軸 解析回数 飛ばした回数 サイクル数" の1行にする(戻り値は書き込んだ文字数)
+	int format(char *buf, int size) const;
+
+private:
+	static void task_entry(void *arg);
+	void analyze();
+};
+
+// 回転因子とハン窓の表を作る(begin()が呼ぶ)
+void fft_init();
+// 基数4の複素FFT(nは4のべき乗, 出力は4進で桁を反転した順)
+// 回転因子はSPECTRUM_SIZE点の表をSPECTRUM_SIZE/n飛びに使う
+void fft_radix4(float *re, float *im, int n);
+// 4進で桁を反転した順を通常の順に並べ替える
+void fft_digit_reverse(float *re, float *im, int n);
+// SPECTRUM_SIZE点の実数FFTの0～SPECTRUM_HALF-1の区間のパワー
+// xはSPECTRUM_SIZE点, re/imは作業用(SPECTRUM_HALF点)
+void fft_real_power(const float *x, float *re, float *im, float *power);
+
+#endif /* __SPECTRUM_H__ */
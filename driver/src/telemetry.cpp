@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <string.h>
+#include "telemetry.h"
+
+static const char *const TELEMETRY_NAME[TELEMETRY_CHANNEL_COUNT] = {
+	"angle", "quat", "gyro", "accel", "mag", "temp", "loop", "motor", "fft"
+};
+
+TELEMETRY::TELEMETRY() {
+	for (int i = 0; i < TELEMETRY_CHANNEL_COUNT; i++) {
+		decimation[i] = 0;
+		count[i] = 0;
+	}
+	decimation[TELEMETRY_ANGLE] = TELEMETRY_DEFAULT_DECIMATION;
+	due = 0;
+}
+
+int TELEMETRY::find(const char *name) {
+	for (int i = 0; i < TELEMETRY_CHANNEL_COUNT; i++) {
+		if (0 == strcmp(TELEMETRY_NAME[i], name)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+const char *TELEMETRY::name(int channel) {
+	return TELEMETRY_NAME[channel];
+}
+
+void TELEMETRY::subscribe(int channel, int decimation) {
+	if (decimation < 0) {
+		decimation = 0;
+	} else if (decimation > TELEMETRY_DECIMATION_MAX) {
+		decimation = TELEMETRY_DECIMATION_MAX;
+	}
+	this->decimation[channel] = decimation;
+	count[channel] = 0;
+}
+
+bool TELEMETRY::tick() {
+	due = 0;
+	for (int i = 0; i < TELEMETRY_CHANNEL_COUNT; i++) {
+		if (0 == decimation[i]) {
+			continue;
+		}
+		if (++count[i] >= decimation[i]) {
+			count[i] = 0;
+			due |= 1u << i;
+		}
+	}
+	return 0 != due;
+}
+
+int TELEMETRY::format(char *buf, int size) const {
+	int n = snprintf(buf, size, "#sub");
+	for (int i = 0; i < TELEMETRY_CHANNEL_COUNT && n < size; i++) {
+		n += snprintf(buf + n, size - n, " %s %d", TELEMETRY_NAME[i], decimation[i]);
+	}
+	if (n < size) {
+		n += snprintf(buf + n, size - n, "\n");
+	}
+	return n < size ? n : size - 1;
+}
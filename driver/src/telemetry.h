@@ -0,0 +1,55 @@
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#include <stdint.h>
+
+// 送信するチャンネル
+// 姿勢角はタグ無しの従来の形式, それ以外は'#'とタグで始まる行にする
+enum TELEMETRY_CHANNEL {
+	TELEMETRY_ANGLE, // "roll,pitch,yaw,ax,ay,az"
+	TELEMETRY_QUAT,  // "#q w,x,y,z"
+	TELEMETRY_GYRO,  // "#g gx,gy,gz" (rad/s)
+	TELEMETRY_ACCEL, // "#a ax,ay,az" (生の値)
+	TELEMETRY_MAG,   // "#m mx,my,mz" (生の値)
+	TELEMETRY_TEMP,  // "#t 温度" (℃)
+	TELEMETRY_LOOP,  // "#l dt(us),センサー読込みからモーター出力まで(us),dtの異常回数"
+	TELEMETRY_MOTOR, // "#o throttle,motor0,motor1,motor2,motor3"
+	TELEMETRY_SPECTRUM, // "#f 周波数,振幅,..." (振動のピーク, 大きい順)
+	TELEMETRY_CHANNEL_COUNT
+};
+
+// 起動時は姿勢角だけを10周期に1回送る
+#define TELEMETRY_DEFAULT_DECIMATION 10
+// 間引きの最大(サンプリング周波数600Hzで約0.1Hz)
+#define TELEMETRY_DECIMATION_MAX     6000
+
+// チャンネルごとの購読と間引き
+// subscribe()で購読したチャンネルだけをtick()が周期ごとに選ぶので
+// 購読していないチャンネルの計算と文字列化は行わない
+class TELEMETRY {
+private:
+	uint16_t decimation[TELEMETRY_CHANNEL_COUNT]; // 0は購読しない
+	uint16_t count[TELEMETRY_CHANNEL_COUNT];
+	uint32_t due;
+
+public:
+	TELEMETRY();
+	// チャンネル名から番号を求める(無ければ-1)
+	static int find(const char *name);
+	static const char *name(int channel);
+	// channelをdecimation周期に1回送る(0で購読をやめる)
+	void subscribe(int channel, int decimation);
+	int get_decimation(int channel) const {
+		return decimation[channel];
+	}
+	// 1周期進めて今回送るチャンネルを決める(どれかあればtrue)
+	bool tick();
+	// 今回送るチャンネルか
+	bool is_due(int channel) const {
+		return due & (1u << channel);
+	}
+	// 購読の一覧を "#sub angle 10 quat 0 ..." の1行にする(戻り値は書き込んだ文字数)
+	int format(char *buf, int size) const;
+};
+
+#endif /* __TELEMETRY_H__ */
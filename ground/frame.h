@@ -0,0 +1,55 @@
+#ifndef __FRAME_H__
+#define __FRAME_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+// テレメトリ1行分
+// 機体からは "roll,pitch,yaw,ax,ay,az" の6項目
+// loadgenは7項目目に送信時刻(us, CLOCK_MONOTONIC)を付ける
+struct FRAME {
+	uint64_t recv_us;  // 受信時刻(us, CLOCK_MONOTONIC)
+	int vehicle;       // 機体の番号(地上局が付ける)
+	uint64_t send_us;  // 送信時刻(0なら無し)
+	float roll, pitch, yaw;
+	int ax, ay, az;
+};
+
+// 単調増加の時刻(us)
+inline uint64_t frame_now_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+
+// "roll,pitch,yaw,ax,ay,az[,send_us]" を解析する
+// 項目が足りなければfalse
+inline bool frame_parse(const char *line, FRAME &f) {
+	char *end;
+	float v[3];
+	for (int i = 0; i < 3; i++) {
+		v[i] = strtof(line, &end);
+		if (end == line || ',' != *end) {
+			return false;
+		}
+		line = end + 1;
+	}
+	long a[3];
+	for (int i = 0; i < 3; i++) {
+		a[i] = strtol(line, &end, 10);
+		if (end == line || (i < 2 && ',' != *end)) {
+			return false;
+		}
+		line = ',' == *end ? end + 1 : end;
+	}
+	f.roll = v[0], f.pitch = v[1], f.yaw = v[2];
+	f.ax = (int)a[0], f.ay = (int)a[1], f.az = (int)a[2];
+	f.send_us = 0;
+	if (',' == end[0]) {
+		f.send_us = strtoull(line, nullptr, 10);
+	}
+	return true;
+}
+
+#endif /* __FRAME_H__ */
@@ -0,0 +1,660 @@
+/* 地上局デーモン
+ *
+ * 複数の機体(ESP32)からのテレメトリを機体ごとの受信スレッドで読み込んで
+ * 機体ごとのロックフリーのリングバッファに入れ, 記録スレッドが受信時刻の順に
+ * 1つのファイルに記録しつつ機体ごとの最新値と間引いた履歴を保持する
+ * 機体はUDPのブロードキャスト("#vehicle <port>")で見つけるか, -hで指定する
+ *
+ * 表示側(monitor等)はローカルのTCPポートに接続して次の行を送る
+ *   vehicles          機体の一覧 "#vehicle 番号 アドレス ポート 接続中"
+ *   latest [v]        機体vの最新の1行 "roll,pitch,yaw,ax,ay,az,seq"
+ *   history [n] [v]   機体vの間引いた履歴の新しい方からn行(古い順), 最後に空行
+ *   gstats            機体ごとの受信統計 "#gstats 番号 frames fps drops errors latency_avg latency_max(us)"
+ *   @v <コマンド>     機体vにコマンドを転送する(@*なら全ての機体)
+ * それ以外の行は機体0に転送する. 機体からの'#'で始まる行は "#v 番号 行" として全ての表示側に転送する
+ *
+ * ビルド:
+ *   c++ -std=c++11 -O2 -pthread -o ground ground.cpp
+ *   c++ -std=c++11 -O2 -pthread -o loadgen loadgen.cpp
+ * 実行:
+ *   ./ground -l 10003 -r log.csv -d 10                 (ブロードキャストで見つける)
+ *   ./ground -u 0 -h 192.168.0.5:10002 -h 192.168.0.6  (指定した機体だけ)
+ * 負荷試験(loadgenが8機の機体の代わりになる):
+ *   ./loadgen -n 8 -p 12002 -r 2000 -t 10 &
+ *   ./ground -r /dev/null
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame.h"
+#include "ring.h"
+
+#define RING_SIZE      8192  // 受信から記録までのバッファ(機体ごとのフレーム数)
+#define HISTORY_MAX    2048  // 間引いた履歴の最大数
+#define TAGGED_MAX     256   // 転送待ちの'#'行の最大数
+#define RECV_SIZE      65536 // 1回に読み込む最大バイト数
+#define VEHICLE_MAX    16    // 機体の最大数
+#define BATCH_MAX      256   // 記録スレッドが1機から1回に取り出す最大数
+#define MERGE_HOLD_US  20000 // 受信時刻の順に並べるために記録を待たせる時間(us)
+
+// 機体ごとの受信状態
+class VEHICLE {
+public:
+	int id;
+	std::string host;
+	int port;
+	RING<FRAME, RING_SIZE> ring;
+	std::thread thread;
+	// 接続(受信スレッドが張り直す)
+	std::mutex fd_mutex;
+	int fd;
+	// 受信統計
+	std::atomic<uint64_t> rx_frames;
+	std::atomic<uint64_t> rx_drops;
+	std::atomic<uint64_t> rx_errors;
+	uint64_t frames_prev;
+	// 最新値と履歴, 遅延(記録スレッドが更新する, GROUND::state_mutexで保護)
+	FRAME latest;
+	uint64_t seq;
+	FRAME history[HISTORY_MAX];
+	size_t history_pos;
+	size_t history_count;
+	uint64_t latency_sum;
+	uint64_t latency_max;
+	uint64_t latency_count;
+
+	VEHICLE();
+};
+
+class GROUND {
+public:
+	// 設定
+	int local_port;
+	int discovery_port;
+	int decimation;
+	FILE *record;
+
+private:
+	// 機体(追加するだけで削除しない. 読む側はvehicle_countまでを見る)
+	std::mutex add_mutex;
+	VEHICLE vehicles[VEHICLE_MAX]; // リングバッファのアラインメントを保つため静的に確保する
+	std::atomic<int> vehicle_count;
+	std::mutex state_mutex;
+	// 機体からの'#'行
+	std::mutex tagged_mutex;
+	std::deque<std::string> tagged;
+
+public:
+	GROUND();
+	VEHICLE *add_vehicle(const std::string &host, int port);
+	void discover();
+	void consume();
+	void serve();
+	void join();
+
+private:
+	void ingest(VEHICLE *v);
+	VEHICLE *find_vehicle(int id);
+	void forward(VEHICLE *v, const char *line, size_t len);
+	void reply(int fd, const char *cmd);
+	std::string stats(double elapsed);
+};
+
+static std::atomic<bool> running(true);
+
+static void on_signal(int) {
+	running = false;
+}
+
+VEHICLE::VEHICLE() {
+	id = 0;
+	port = 0;
+	fd = -1;
+	rx_frames = 0;
+	rx_drops = 0;
+	rx_errors = 0;
+	frames_prev = 0;
+	memset(&latest, 0, sizeof(latest));
+	seq = 0;
+	history_pos = 0;
+	history_count = 0;
+	latency_sum = 0;
+	latency_max = 0;
+	latency_count = 0;
+}
+
+GROUND::GROUND() {
+	local_port = 10003;
+	discovery_port = 10001;
+	decimation = 10;
+	record = nullptr;
+	vehicle_count = 0;
+}
+
+VEHICLE *GROUND::add_vehicle(const std::string &host, int port) {
+	std::lock_guard<std::mutex> lock(add_mutex);
+	int n = vehicle_count;
+	for (int i = 0; i < n; i++) {
+		if (vehicles[i].host == host && vehicles[i].port == port) {
+			return &vehicles[i];
+		}
+	}
+	if (n >= VEHICLE_MAX) {
+		return nullptr;
+	}
+	VEHICLE *v = &vehicles[n];
+	v->id = n;
+	v->host = host;
+	v->port = port;
+	v->thread = std::thread(&GROUND::ingest, this, v);
+	vehicle_count = n + 1;
+	fprintf(stderr, "vehicle %d %s:%d\n", n, host.c_str(), port);
+	return v;
+}
+
+VEHICLE *GROUND::find_vehicle(int id) {
+	return 0 <= id && id < vehicle_count ? &vehicles[id] : nullptr;
+}
+
+void GROUND::join() {
+	int n = vehicle_count;
+	for (int i = 0; i < n; i++) {
+		vehicles[i].thread.join();
+	}
+}
+
+static int connect_tcp(const std::string &host, int port) {
+	struct addrinfo hints, *res;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	char port_str[16];
+	snprintf(port_str, sizeof(port_str), "%d", port);
+	if (0 != getaddrinfo(host.c_str(), port_str, &hints, &res)) {
+		return -1;
+	}
+	int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+	if (fd >= 0 && 0 != connect(fd, res->ai_addr, res->ai_addrlen)) {
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	if (fd >= 0) {
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	}
+	return fd;
+}
+
+// ブロードキャストされた "#vehicle <port>" を受け取って機体を追加する
+void GROUND::discover() {
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	int one = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(discovery_port);
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+		fprintf(stderr, "discovery %d: %s\n", discovery_port, strerror(errno));
+		close(fd);
+		return;
+	}
+	while (running) {
+		struct pollfd p = { fd, POLLIN, 0 };
+		if (poll(&p, 1, 100) <= 0) {
+			continue;
+		}
+		char buf[64];
+		struct sockaddr_in src;
+		socklen_t len = sizeof(src);
+		ssize_t n = recvfrom(fd, buf, sizeof(buf) - 1, 0, (struct sockaddr*)&src, &len);
+		if (n <= 0) {
+			continue;
+		}
+		buf[n] = 0;
+		int port;
+		if (1 == sscanf(buf, "#vehicle %d", &port)) {
+			char host[INET_ADDRSTRLEN];
+			inet_ntop(AF_INET, &src.sin_addr, host, sizeof(host));
+			add_vehicle(host, port);
+		}
+	}
+	close(fd);
+}
+
+// 受信スレッド: 読めるだけ読み込んで行ごとに解析し, 機体のリングバッファに入れる
+void GROUND::ingest(VEHICLE *v) {
+	std::vector<char> buf(RECV_SIZE + 256);
+	size_t used = 0;
+	while (running) {
+		int fd = connect_tcp(v->host, v->port);
+		if (fd < 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(500));
+			continue;
+		}
+		fprintf(stderr, "connected %d %s:%d\n", v->id, v->host.c_str(), v->port);
+		{
+			std::lock_guard<std::mutex> lock(v->fd_mutex);
+			v->fd = fd;
+		}
+		used = 0;
+		while (running) {
+			struct pollfd p = { fd, POLLIN, 0 };
+			if (poll(&p, 1, 100) <= 0) {
+				continue;
+			}
+			ssize_t n = read(fd, buf.data() + used, buf.size() - 1 - used);
+			if (n <= 0) {
+				break;
+			}
+			uint64_t now = frame_now_us();
+			used += n;
+			buf[used] = 0;
+			char *line = buf.data();
+			char *nl;
+			while (nullptr != (nl = (char*)memchr(line, '\n', used - (line - buf.data())))) {
+				*nl = 0;
+				if ('#' == line[0]) {
+					char head[16];
+					snprintf(head, sizeof(head), "#v %d ", v->id);
+					std::lock_guard<std::mutex> lock(tagged_mutex);
+					if (tagged.size() < TAGGED_MAX) {
+						tagged.push_back(head + std::string(line) + "\n");
+					}
+				} else {
+					FRAME f;
+					if (frame_parse(line, f)) {
+						f.recv_us = now;
+						f.vehicle = v->id;
+						if (v->ring.push(f)) {
+							v->rx_frames++;
+						} else {
+							v->rx_drops++;
+						}
+					} else {
+						v->rx_errors++;
+					}
+				}
+				line = nl + 1;
+			}
+			// 途中までの行を先頭に寄せる(長すぎる行は捨てる)
+			used -= line - buf.data();
+			if (used >= buf.size() - 1) {
+				used = 0;
+				v->rx_errors++;
+			}
+			memmove(buf.data(), line, used);
+		}
+		{
+			std::lock_guard<std::mutex> lock(v->fd_mutex);
+			v->fd = -1;
+		}
+		close(fd);
+		fprintf(stderr, "disconnected %d\n", v->id);
+	}
+}
+
+// 記録ファイルの1行 "recv_us,vehicle,roll,pitch,yaw,ax,ay,az"
+static void record_frame(FILE *fp, const FRAME &f) {
+	fprintf(fp, "%llu,%d,%f,%f,%f,%d,%d,%d\n",
+		(unsigned long long)f.recv_us, f.vehicle,
+		f.roll, f.pitch, f.yaw,
+		f.ax, f.ay, f.az
+	);
+}
+
+// 記録スレッド: 機体ごとに最新値と履歴を更新し, 全ての機体のフレームを
+// 受信時刻の順に並べて記録する
+void GROUND::consume() {
+	std::vector<FRAME> pending;
+	pending.reserve(BATCH_MAX * VEHICLE_MAX * 2);
+	while (running) {
+		size_t added = 0;
+		uint64_t now = frame_now_us();
+		int count = vehicle_count;
+		for (int i = 0; i < count; i++) {
+			VEHICLE *v = &vehicles[i];
+			std::lock_guard<std::mutex> lock(state_mutex);
+			FRAME f;
+			for (int k = 0; k < BATCH_MAX && v->ring.pop(f); k++) {
+				if (0 != f.send_us && now >= f.send_us) {
+					uint64_t latency = now - f.send_us;
+					v->latency_sum += latency;
+					v->latency_count++;
+					if (latency > v->latency_max) {
+						v->latency_max = latency;
+					}
+				}
+				if (0 == v->seq % decimation) {
+					v->history[v->history_pos] = f;
+					v->history_pos = (v->history_pos + 1) % HISTORY_MAX;
+					if (v->history_count < HISTORY_MAX) {
+						v->history_count++;
+					}
+				}
+				v->seq++;
+				v->latest = f;
+				if (nullptr != record) {
+					pending.push_back(f);
+				}
+				added++;
+			}
+		}
+		if (0 == added) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		if (pending.empty()) {
+			continue;
+		}
+		// 全ての機体で共通の時間軸に並べる
+		// 他の機体のリングにまだ残っているフレームを追い越さないよう, MERGE_HOLD_US以内に受信したものは次に回す
+		std::stable_sort(pending.begin(), pending.end(), [](const FRAME &a, const FRAME &b) {
+			return a.recv_us < b.recv_us;
+		});
+		size_t n = 0;
+		for (; n < pending.size() && pending[n].recv_us + MERGE_HOLD_US <= now; n++) {
+			record_frame(record, pending[n]);
+		}
+		pending.erase(pending.begin(), pending.begin() + n);
+	}
+	// 終了時は残りを全て記録する
+	for (const FRAME &f : pending) {
+		record_frame(record, f);
+	}
+}
+
+void GROUND::forward(VEHICLE *v, const char *line, size_t len) {
+	std::lock_guard<std::mutex> lock(v->fd_mutex);
+	if (v->fd >= 0) {
+		if (write(v->fd, line, len) < 0) {
+			fprintf(stderr, "forward %d: %s\n", v->id, strerror(errno));
+		}
+	}
+}
+
+// 機体ごとの統計(elapsedが0ならfpsは0)
+std::string GROUND::stats(double elapsed) {
+	std::string out;
+	int count = vehicle_count;
+	std::lock_guard<std::mutex> lock(state_mutex);
+	for (int i = 0; i < count; i++) {
+		VEHICLE *v = &vehicles[i];
+		uint64_t frames = v->rx_frames;
+		double fps = 0;
+		if (elapsed > 0) {
+			fps = (frames - v->frames_prev) / elapsed;
+			v->frames_prev = frames;
+		}
+		uint64_t avg = v->latency_count ? v->latency_sum / v->latency_count : 0;
+		char buf[160];
+		snprintf(buf, sizeof(buf), "#gstats %d %llu %.0f %llu %llu %llu %llu\n",
+			v->id, (unsigned long long)frames, fps,
+			(unsigned long long)v->rx_drops, (unsigned long long)v->rx_errors,
+			(unsigned long long)avg, (unsigned long long)v->latency_max
+		);
+		out.append(buf);
+		if (elapsed > 0) {
+			v->latency_sum = 0;
+			v->latency_max = 0;
+			v->latency_count = 0;
+		}
+	}
+	return out;
+}
+
+static void send_all(int fd, const char *buf, size_t len) {
+	while (len > 0) {
+		ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+		if (n <= 0) {
+			return;
+		}
+		buf += n;
+		len -= n;
+	}
+}
+
+static int format_frame(char *buf, size_t size, const FRAME &f, uint64_t seq) {
+	return snprintf(buf, size, "%f,%f,%f,%d,%d,%d,%llu\n",
+		f.roll, f.pitch, f.yaw, f.ax, f.ay, f.az, (unsigned long long)seq
+	);
+}
+
+void GROUND::reply(int fd, const char *cmd) {
+	char buf[256];
+	if (0 == strcmp("vehicles", cmd)) {
+		std::string out;
+		int count = vehicle_count;
+		for (int i = 0; i < count; i++) {
+			VEHICLE *v = &vehicles[i];
+			bool connected;
+			{
+				std::lock_guard<std::mutex> lock(v->fd_mutex);
+				connected = v->fd >= 0;
+			}
+			snprintf(buf, sizeof(buf), "#vehicle %d %s %d %d\n", v->id, v->host.c_str(), v->port, connected ? 1 : 0);
+			out.append(buf);
+		}
+		send_all(fd, out.data(), out.size());
+	} else if (0 == strncmp("latest", cmd, 6)) {
+		VEHICLE *v = find_vehicle(' ' == cmd[6] ? atoi(cmd + 7) : 0);
+		if (nullptr == v) {
+			send_all(fd, "\n", 1);
+			return;
+		}
+		FRAME f;
+		uint64_t seq;
+		{
+			std::lock_guard<std::mutex> lock(state_mutex);
+			f = v->latest;
+			seq = v->seq;
+		}
+		int n = format_frame(buf, sizeof(buf), f, seq);
+		send_all(fd, buf, n);
+	} else if (0 == strncmp("history", cmd, 7)) {
+		unsigned long count = HISTORY_MAX;
+		int id = 0;
+		sscanf(cmd + 7, "%lu %d", &count, &id);
+		VEHICLE *v = find_vehicle(id);
+		std::string out;
+		if (nullptr != v) {
+			std::lock_guard<std::mutex> lock(state_mutex);
+			if (count > v->history_count) {
+				count = v->history_count;
+			}
+			size_t pos = (v->history_pos + HISTORY_MAX - count) % HISTORY_MAX;
+			for (size_t i = 0; i < count; i++) {
+				int n = format_frame(buf, sizeof(buf), v->history[pos], 0);
+				out.append(buf, n);
+				pos = (pos + 1) % HISTORY_MAX;
+			}
+		}
+		out.append("\n");
+		send_all(fd, out.data(), out.size());
+	} else if (0 == strcmp("gstats", cmd)) {
+		std::string out = stats(0);
+		send_all(fd, out.data(), out.size());
+	} else if ('@' == cmd[0]) {
+		// 機体を指定したコマンド
+		const char *body = strchr(cmd, ' ');
+		if (nullptr == body) {
+			return;
+		}
+		std::string line(body + 1);
+		line.append("\n");
+		if ('*' == cmd[1]) {
+			int count = vehicle_count;
+			for (int i = 0; i < count; i++) {
+				forward(&vehicles[i], line.data(), line.size());
+			}
+		} else {
+			VEHICLE *v = find_vehicle(atoi(cmd + 1));
+			if (nullptr != v) {
+				forward(v, line.data(), line.size());
+			}
+		}
+	} else {
+		VEHICLE *v = find_vehicle(0);
+		if (nullptr != v) {
+			std::string line(cmd);
+			line.append("\n");
+			forward(v, line.data(), line.size());
+		}
+	}
+}
+
+// 表示側の接続を受け付けて要求に応える
+void GROUND::serve() {
+	int lfd = socket(AF_INET, SOCK_STREAM, 0);
+	int one = 1;
+	setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(local_port);
+	if (bind(lfd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(lfd, 8) < 0) {
+		fprintf(stderr, "listen %d: %s\n", local_port, strerror(errno));
+		running = false;
+		return;
+	}
+	std::vector<struct pollfd> fds;
+	std::vector<std::string> lines;
+	fds.push_back({ lfd, POLLIN, 0 });
+	lines.push_back("");
+	auto stats_time = std::chrono::steady_clock::now();
+	while (running) {
+		poll(fds.data(), fds.size(), 100);
+		if (fds[0].revents & POLLIN) {
+			int fd = accept(lfd, nullptr, nullptr);
+			if (fd >= 0) {
+				setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+				fds.push_back({ fd, POLLIN, 0 });
+				lines.push_back("");
+			}
+		}
+		for (size_t i = 1; i < fds.size(); i++) {
+			if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+				continue;
+			}
+			char buf[1024];
+			ssize_t n = read(fds[i].fd, buf, sizeof(buf));
+			if (n <= 0) {
+				close(fds[i].fd);
+				fds.erase(fds.begin() + i);
+				lines.erase(lines.begin() + i);
+				i--;
+				continue;
+			}
+			lines[i].append(buf, n);
+			size_t nl;
+			while (std::string::npos != (nl = lines[i].find('\n'))) {
+				std::string cmd = lines[i].substr(0, nl);
+				lines[i].erase(0, nl + 1);
+				if (!cmd.empty() && '\r' == cmd.back()) {
+					cmd.pop_back();
+				}
+				reply(fds[i].fd, cmd.c_str());
+			}
+		}
+		// 機体からの'#'行を表示側に転送
+		std::deque<std::string> out;
+		{
+			std::lock_guard<std::mutex> lock(tagged_mutex);
+			out.swap(tagged);
+		}
+		for (auto &line : out) {
+			for (size_t i = 1; i < fds.size(); i++) {
+				send_all(fds[i].fd, line.data(), line.size());
+			}
+		}
+		// 1秒ごとに統計を表示
+		auto now = std::chrono::steady_clock::now();
+		double elapsed = std::chrono::duration<double>(now - stats_time).count();
+		if (elapsed >= 1.0) {
+			stats_time = now;
+			fputs(stats(elapsed).c_str(), stderr);
+		}
+	}
+	for (auto &p : fds) {
+		close(p.fd);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	static GROUND ground;
+	std::vector<std::string> hosts;
+	const char *record_path = nullptr;
+	int opt;
+	while (-1 != (opt = getopt(argc, argv, "h:l:u:r:d:"))) {
+		switch (opt) {
+		case 'h': hosts.push_back(optarg); break;
+		case 'l': ground.local_port = atoi(optarg); break;
+		case 'u': ground.discovery_port = atoi(optarg); break;
+		case 'r': record_path = optarg; break;
+		case 'd': ground.decimation = atoi(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-h host[:port]]... [-l local_port] [-u discovery_port(0:off)] [-r record.csv] [-d decimation]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (ground.decimation < 1) {
+		ground.decimation = 1;
+	}
+	if (nullptr != record_path) {
+		ground.record = fopen(record_path, "w");
+		if (nullptr == ground.record) {
+			perror(record_path);
+			return 1;
+		}
+		setvbuf(ground.record, nullptr, _IOFBF, 1 << 20);
+	}
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	signal(SIGPIPE, SIG_IGN);
+	for (auto &h : hosts) {
+		size_t colon = h.find(':');
+		int port = 10002;
+		if (std::string::npos != colon) {
+			port = atoi(h.c_str() + colon + 1);
+			h.resize(colon);
+		}
+		ground.add_vehicle(h, port);
+	}
+	std::thread discover_thread;
+	if (0 != ground.discovery_port) {
+		discover_thread = std::thread(&GROUND::discover, &ground);
+	}
+	std::thread consume_thread(&GROUND::consume, &ground);
+	ground.serve();
+	running = false;
+	if (discover_thread.joinable()) {
+		discover_thread.join();
+	}
+	ground.join();
+	consume_thread.join();
+	if (nullptr != ground.record) {
+		fclose(ground.record);
+	}
+	return 0;
+}
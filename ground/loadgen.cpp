@@ -0,0 +1,202 @@
+/* 地上局の負荷試験用に機体の代わりをするテレメトリ送信器
+ *
+ * ポートで待ち受けて, 接続してきた地上局に "roll,pitch,yaw,ax,ay,az,send_us" を
+ * 指定したレートで送る(send_usはCLOCK_MONOTONIC, 地上局が遅延の計測に使う)
+ * -nで複数の機体を模擬する(ポートはport～port+n-1). 各機体は接続されるまで
+ * 1秒ごとに "#vehicle <port>" を127.0.0.1の発見用ポートに送る(機体のブロードキャストの代わり)
+ * 受信したコマンド行は標準エラーに表示する
+ *
+ * ビルド:
+ *   c++ -std=c++11 -O2 -pthread -o loadgen loadgen.cpp
+ * 実行:
+ *   ./loadgen -p 10002 -r 5000 -t 10
+ *   ./loadgen -n 8 -p 12002 -r 2000 -t 10 -u 10001
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame.h"
+
+struct VEHICLE_SIM {
+	int port;
+	double rate;
+	double duration;
+	int discovery_port;
+	// 結果
+	uint64_t sent;
+	uint64_t bytes;
+	double elapsed;
+	bool ok;
+};
+
+// 接続されるまで発見用のビーコンを送りながら待つ
+static int wait_connect(int lfd, const VEHICLE_SIM &sim) {
+	int ufd = -1;
+	struct sockaddr_in dst;
+	if (0 != sim.discovery_port) {
+		ufd = socket(AF_INET, SOCK_DGRAM, 0);
+		memset(&dst, 0, sizeof(dst));
+		dst.sin_family = AF_INET;
+		dst.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		dst.sin_port = htons(sim.discovery_port);
+	}
+	char beacon[32];
+	int len = snprintf(beacon, sizeof(beacon), "#vehicle %d\n", sim.port);
+	int fd = -1;
+	while (fd < 0) {
+		if (ufd >= 0) {
+			sendto(ufd, beacon, len, 0, (struct sockaddr*)&dst, sizeof(dst));
+		}
+		struct pollfd p = { lfd, POLLIN, 0 };
+		if (poll(&p, 1, 1000) > 0) {
+			fd = accept(lfd, nullptr, nullptr);
+		}
+	}
+	if (ufd >= 0) {
+		close(ufd);
+	}
+	return fd;
+}
+
+static void run(VEHICLE_SIM *sim) {
+	sim->ok = false;
+	sim->sent = 0;
+	sim->bytes = 0;
+	sim->elapsed = 0;
+	int lfd = socket(AF_INET, SOCK_STREAM, 0);
+	int one = 1;
+	setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(sim->port);
+	if (bind(lfd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(lfd, 1) < 0) {
+		fprintf(stderr, "listen %d: %s\n", sim->port, strerror(errno));
+		close(lfd);
+		return;
+	}
+	int fd = wait_connect(lfd, *sim);
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	// 1ms毎に, 開始からの経過時間ぶんのフレームをまとめて送る
+	const double rate = sim->rate;
+	const uint64_t start = frame_now_us();
+	const uint64_t end = start + (uint64_t)(sim->duration * 1e6);
+	uint64_t sent = 0;
+	uint64_t bytes = 0;
+	std::string out;
+	char cmd[1024];
+	while (1) {
+		uint64_t now = frame_now_us();
+		if (now >= end) {
+			break;
+		}
+		uint64_t due = (uint64_t)((now - start) * 1e-6 * rate);
+		out.clear();
+		for (; sent < due; sent++) {
+			char line[128];
+			float t = sent / rate;
+			int n = snprintf(line, sizeof(line), "%f,%f,%f,%d,%d,%d,%llu\n",
+				0.5f * sinf(t), 0.5f * cosf(t), t,
+				(int)(16384 * sinf(3 * t)), (int)(16384 * cosf(3 * t)), 16384,
+				(unsigned long long)now
+			);
+			out.append(line, n);
+		}
+		if (!out.empty()) {
+			ssize_t n = send(fd, out.data(), out.size(), MSG_NOSIGNAL);
+			if (n < 0) {
+				perror("send");
+				break;
+			}
+			bytes += n;
+		}
+		// 地上局から転送されたコマンド
+		struct pollfd p = { fd, POLLIN, 0 };
+		if (poll(&p, 1, 1) > 0) {
+			ssize_t n = read(fd, cmd, sizeof(cmd) - 1);
+			if (n <= 0) {
+				break;
+			}
+			cmd[n] = 0;
+			fprintf(stderr, "command %d: %s", sim->port, cmd);
+		}
+	}
+	sim->elapsed = (frame_now_us() - start) * 1e-6;
+	sim->sent = sent;
+	sim->bytes = bytes;
+	sim->ok = true;
+	close(fd);
+	close(lfd);
+}
+
+int main(int argc, char *argv[]) {
+	int port = 10002;
+	int count = 1;
+	int discovery_port = 0;
+	double rate = 600;
+	double duration = 10;
+	int opt;
+	while (-1 != (opt = getopt(argc, argv, "p:n:u:r:t:"))) {
+		switch (opt) {
+		case 'p': port = atoi(optarg); break;
+		case 'n': count = atoi(optarg); break;
+		case 'u': discovery_port = atoi(optarg); break;
+		case 'r': rate = atof(optarg); break;
+		case 't': duration = atof(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-p port] [-n vehicles] [-u discovery_port] [-r frames/s] [-t seconds]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (count < 1) {
+		count = 1;
+	}
+	// 複数の機体は発見されないと接続されないので既定で発見用ポートに送る
+	if (count > 1 && 0 == discovery_port) {
+		discovery_port = 10001;
+	}
+	signal(SIGPIPE, SIG_IGN);
+	std::vector<VEHICLE_SIM> sims(count);
+	std::vector<std::thread> threads;
+	for (int i = 0; i < count; i++) {
+		sims[i].port = port + i;
+		sims[i].rate = rate;
+		sims[i].duration = duration;
+		sims[i].discovery_port = discovery_port;
+		threads.push_back(std::thread(run, &sims[i]));
+	}
+	uint64_t total = 0;
+	double fps = 0;
+	for (int i = 0; i < count; i++) {
+		threads[i].join();
+		const VEHICLE_SIM &s = sims[i];
+		if (!s.ok) {
+			continue;
+		}
+		fprintf(stderr, "%d: sent %llu frames %llu bytes in %.2fs (%.0f frames/s)\n",
+			s.port, (unsigned long long)s.sent, (unsigned long long)s.bytes, s.elapsed, s.sent / s.elapsed
+		);
+		total += s.sent;
+		fps += s.sent / s.elapsed;
+	}
+	if (count > 1) {
+		fprintf(stderr, "total %llu frames (%.0f frames/s)\n", (unsigned long long)total, fps);
+	}
+	return 0;
+}
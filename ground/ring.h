@@ -0,0 +1,45 @@
+#ifndef __RING_H__
+#define __RING_H__
+
+#include <atomic>
+#include <stddef.h>
+
+// 1対1(書込み1スレッド, 読出し1スレッド)のロックフリーなリングバッファ
+// SIZEは2のべき乗
+template <class T, size_t SIZE>
+class RING {
+private:
+	static_assert(0 == (SIZE & (SIZE - 1)), "SIZE must be a power of 2");
+	T buf[SIZE];
+	// 書込み位置と読出し位置(それぞれ書込み側と読出し側だけが更新する)
+	alignas(64) std::atomic<size_t> head;
+	alignas(64) std::atomic<size_t> tail;
+
+public:
+	RING() : head(0), tail(0) { }
+	// 書込み側: 満杯ならfalse
+	bool push(const T &v) {
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) >= SIZE) {
+			return false;
+		}
+		buf[h & (SIZE - 1)] = v;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+	// 読出し側: 空ならfalse
+	bool pop(T &v) {
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t == head.load(std::memory_order_acquire)) {
+			return false;
+		}
+		v = buf[t & (SIZE - 1)];
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+	size_t size() const {
+		return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+	}
+};
+
+#endif /* __RING_H__ */
@@ -16,6 +16,18 @@ float mScale = 0.4f;
 
 vec3 mA = new vec3();
 
+// 姿勢角の送信周期("wifi"コマンドの間引き)とESP32のサンプリング周波数
+final int TELEMETRY_DECIMATION = 10;
+final float TELEMETRY_RATE = 600.0f / TELEMETRY_DECIMATION; // 1秒あたりの行数
+
+// 受信状況
+int mRecvCount = 0;        // 直前のフレームで読み込んだ行数
+long mRecvTotal = 0;       // 受信した行数(サンプルの通し番号)
+int mRecvStartMillis = -1; // 最初の行を受信した時刻(ms)
+float mLeadMax = -1e9f;    // 送信周期から予想した行数に対する受信数の進みの最大
+float mLagMillis = 0;      // 表示しているサンプルの遅れ(ms)
+float mFrameMillis = 0;    // 直前のフレームの描画時間(ms)
+
 final int SEND_INTERVAL = 10;
 int mSendIntervalCount = 0;
 boolean mPSend = false;
@@ -27,12 +39,12 @@ float mPY = 0.0f;
 void setup() {
     mClient = new Client(this, ipaddress, port);
     println("wifi connected");
-    mClient.write("wifi 10\n");
+    mClient.write("wifi " + TELEMETRY_DECIMATION + "\n");
     mClient.write("beta 1.3\n");
-    mClient.write("gscale 1e+1\n");
+    mClient.write("gscale 1\n");
     mClient.write("mscale 0\n");
-    mPlot = new Plot(3, width);
     size(1024, 768, P3D);
+    mPlot = new Plot(3, 8192);
 }
 
 void mouseDragged() {
@@ -55,27 +67,58 @@ void mouseReleased() {
 }
 
 void receive() {
-    if (0 == mClient.available()) {
-        return;
+    // 溜まっている行を全部読み込む
+    // 波形には全ての値を追加し, 姿勢は最新の値だけを表示する
+    mRecvCount = 0;
+    while (0 < mClient.available()) {
+        String str = mClient.readStringUntil('\n');
+        if (null == str) {
+            break;
+        }
+        // '#'で始まる行は購読したチャンネルや応答なので姿勢の表示には使わない
+        if (str.startsWith("#")) {
+            continue;
+        }
+        String toks[] = split(trim(str), ",");
+        if (6 > toks.length) {
+            continue;
+        }
+        mRoll = float(toks[0]);
+        mPitch = float(toks[1]);
+        mYaw = float(toks[2]);
+        mA.x = float(toks[3]);
+        mA.y = float(toks[4]);
+        mA.z = float(toks[5]);
+        mPlot.push(mA.x/32768, mA.y/32768, mA.z/32768);
+        mRecvCount++;
+        mRecvTotal++;
+        if (mRecvStartMillis < 0) {
+            mRecvStartMillis = millis();
+        }
     }
-    // 1行読み込み
-    String str = mClient.readStringUntil('\n');
-    if (null == str) {
-        return;
+    // 行には時刻が無いので, 受信した通し番号と送信周期から予想した番号の差で遅れを求める
+    // 差が最も進んでいたとき(最も遅れが少なかったとき)を基準にして,
+    // それより遅れている分を表示しているサンプル(最新の受信)の遅れとする
+    if (mRecvStartMillis >= 0) {
+        float expected = (millis() - mRecvStartMillis) * TELEMETRY_RATE / 1000;
+        float lead = mRecvTotal - expected;
+        if (lead > mLeadMax) {
+            mLeadMax = lead;
+        }
+        mLagMillis = (mLeadMax - lead) * 1000 / TELEMETRY_RATE;
     }
-    String toks[] = split(trim(str), ",");
-    if (6 > toks.length) {
-        return;
-    }
-    mRoll = float(toks[0]);
-    mPitch = float(toks[1]);
-    mYaw = float(toks[2]);
-    mA.x = float(toks[3]);
-    mA.y = float(toks[4]);
-    mA.z = float(toks[5]);
+}
+
+void drawLag() {
+    // 表示しているサンプルの遅れと, 1フレームで読み込んだ行数
+    fill(255);
+    textSize(16);
+    text("lag " + nf(mLagMillis, 0, 1) + "ms  rx " + mRecvCount + "/frame  " + nf(frameRate, 0, 1) + "fps", 10, 20);
+    text("frame " + nf(mFrameMillis, 0, 2) + "ms  plot " + nf(mPlot.getDrawMillis(), 0, 2) + "ms", 10, 40);
 }
 
 void draw() {
+    final long frameStart = System.nanoTime();
     if (++mSendIntervalCount >= SEND_INTERVAL) {
       mSendIntervalCount = 0;
       if (!mPSend) {
@@ -84,6 +127,8 @@ void draw() {
       }
     }
     background(0);
+    receive();
+    drawLag();
     mOffsetX = width / 2;
     mOffsetY = height / 2;
     translate(mOffsetX, mOffsetY, -100);
@@ -91,7 +136,6 @@ void draw() {
     ambientLight(50, 50, 50);                  // 環境光を当てる
     lightSpecular(255, 255, 255);              // 光の鏡面反射色（ハイライト）を設定
     directionalLight(100, 100, 100, 0, 1, -1); // 指向性ライトを設定
-    receive();
     // カーソル位置を中心に円を描く
     specular(0, 255, 0);
     ellipse(0, 0, 50, 50);
@@ -101,9 +145,7 @@ void draw() {
       /* Waves */
       pushMatrix();
       translate(0, -height/4, 0);
-      mPlot.plot(width*2, 1000,
-          mA.x/32768, mA.y/32768, mA.z/32768
-      );
+      mPlot.draw(width*2, 1000);
       popMatrix();
     }
     if (false) {
@@ -121,4 +163,5 @@ void draw() {
       drawRP(mRoll, mPitch);
       popMatrix();
     }
+    mFrameMillis = (System.nanoTime() - frameStart) * 1e-6f;
 }
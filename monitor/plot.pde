@@ -1,49 +1,91 @@
 class Plot {
-    private int mPos = 0;
-    private int[][] mData;
+    private int mPos = 0;       // 次に書き込む位置
+    private int mCount = 0;     // 保持している値の数
+    private float[][] mData;
+    private float mDrawMillis = 0;
 
     public Plot(int plotCount, int dataLength) {
-        mData = new int[plotCount][];
+        mData = new float[plotCount][];
         for (int i = 0; i < plotCount; i++) {
-            mData[i] = new int[dataLength];
+            mData[i] = new float[dataLength];
         }
     }
 
-    public void plot(int w, int h, float...v) {
+    // 値を追加する(-1～1)
+    public void push(float...v) {
         final int PlotCount = mData.length;
         final int DataLength = mData[0].length;
-        final float ScaleX = (float)w / DataLength;
+        for (int i = 0; i < PlotCount && i < v.length; i++) {
+            mData[i][mPos] = v[i];
+        }
+        mPos++;
+        if (mPos >= DataLength) {
+            mPos = 0;
+        }
+        if (mCount < DataLength) {
+            mCount++;
+        }
+    }
+
+    // 前回のdraw()にかかった時間(ms)
+    public float getDrawMillis() {
+        return mDrawMillis;
+    }
+
+    // 古い値から順に, 画面の横1ピクセルあたりの最小値と最大値を結んで描く
+    // チャンネルごとに1つのシェイプにまとめる
+    public void draw(int w, int h) {
+        final long start = System.nanoTime();
+        final int PlotCount = mData.length;
+        final int DataLength = mData[0].length;
+        final int Columns = min(mCount, w);
         final float ScaleY = h * 0.5f / PlotCount;
         final int OfsX = w / 2;
         final int OfsY = -h * 5 / 8;
+        final int Oldest = mCount < DataLength ? 0 : mPos;
         strokeWeight(4);
+        noFill();
         for (int i = 0; i < PlotCount; i++) {
-            if (0 != v.length) {
-                mData[i][mPos] = (int)(ScaleY * v[i]);
-            }
             int ofsP = OfsY + (int)(i * (float)h / PlotCount);
             stroke(127,127,127);
             line( -OfsX, ofsP, OfsX, ofsP);
-            switch(i % 3) {
+            if (0 == Columns) {
+                continue;
+            }
+            switch(i % 6) {
                 case 0 : stroke(0,255,0); break;
                 case 1 : stroke(255,0,0); break;
                 case 2 : stroke(191,0,191); break;
+                case 3 : stroke(0,191,255); break;
+                case 4 : stroke(255,191,0); break;
+                case 5 : stroke(255,255,255); break;
             }
-            int xa = -OfsX;
-            int ya = ofsP + mData[i][0];
-            for (int t = 1; t < DataLength; t++) {
-                int xb = (int)(t * ScaleX - OfsX);
-                int yb = ofsP + mData[i][t];
-                line(xa, ya,xb, yb);
-                xa = xb;
-                ya = yb;
-            }
-        }
-        if (0 != v.length) {
-            mPos++;
-            if (mPos >= DataLength) {
-                mPos = 0;
+            final float[] data = mData[i];
+            beginShape();
+            int k = 0;
+            int idx = Oldest;
+            for (int c = 0; c < Columns; c++) {
+                // この列に入る値の範囲
+                final int end = (int)((long)(c + 1) * mCount / Columns);
+                float vmin = data[idx];
+                float vmax = vmin;
+                for (; k < end; k++) {
+                    final float v = data[idx];
+                    if (v < vmin) vmin = v;
+                    if (v > vmax) vmax = v;
+                    idx++;
+                    if (idx >= DataLength) {
+                        idx = 0;
+                    }
+                }
+                final float x = (float)c * w / Columns - OfsX;
+                vertex(x, ofsP + ScaleY * vmin);
+                if (vmax != vmin) {
+                    vertex(x, ofsP + ScaleY * vmax);
+                }
             }
+            endShape();
         }
+        mDrawMillis = (System.nanoTime() - start) * 1e-6f;
     }
 }
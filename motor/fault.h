@@ -0,0 +1,129 @@
+#ifndef __FAULT_H__
+#define __FAULT_H__
+
+/* 異常検出
+ * 位相検出(step24_set_phase)と速度推定(velocity.h)の結果から
+ * 脱調, 同期外れ, 逆転, 過電流を検出して出力振幅を絞る
+ * 振幅は0-255で扱い, 異常時は1ループごとに1/4ずつ(最大20ループ)で0まで下げる */
+
+#define FAULT_STALL       0x01 /* 脱調(駆動しているのに回らない) */
+#define FAULT_DESYNC      0x02 /* 同期外れ(指令位相と検出位相のずれが大きい) */
+#define FAULT_REVERSE     0x04 /* 逆転(半周期以上戻る位相変化が続く) */
+#define FAULT_OVERCURRENT 0x08 /* 過電流 */
+#define FAULT_START       0x10 /* 始動失敗(加速中に検出位相が追従しない, startup.hで設定) */
+
+#define FAULT_STALL_AMP      64  /* この振幅以上で */
+#define FAULT_STALL_VELOCITY 8   /* velocity_valueがこれ未満なら脱調 */
+#define FAULT_STALL_WINDOWS  16  /* TMR1周期(8.192ms)の回数 */
+#define FAULT_SYNC_VELOCITY  32  /* この速度以上で同期を監視する */
+#define FAULT_LAG_MAX        6   /* 指令位相と検出位相のずれの許容値(1/24周期単位) */
+#define FAULT_DESYNC_WINDOWS 8
+#define FAULT_REVERSE_COUNT  4   /* TMR1周期内の逆方向の位相変化の回数 */
+#define FAULT_CURRENT_LIMIT  200 /* 電流検出ADC値(上位8bit)の上限 */
+#define FAULT_CURRENT_COUNT  2
+#define FAULT_HOLD_WINDOWS   64  /* 振幅を0にしてから再始動まで待つ回数 */
+
+/******************************************************************************/
+char fault_flags = 0;
+unsigned char fault_amp_limit = 255;
+char fault_restart = 0; /* 異常から復帰したら1, 始動側で0に戻す */
+char fault_window = 0;
+char fault_stall_count = 0;
+char fault_desync_count = 0;
+char fault_current_count = 0;
+char fault_hold_count = 0;
+
+/******************************************************************************/
+/* TMR1割込みで監視周期を進める */
+#define FAULT_SET_WINDOW (fault_window = 1)
+
+/* 電流検出ADC値を与える */
+inline void
+fault_current(unsigned char adc) {
+    if (adc < FAULT_CURRENT_LIMIT) {
+        fault_current_count = 0;
+        return;
+    }
+    if (++fault_current_count >= FAULT_CURRENT_COUNT) {
+        fault_flags |= FAULT_OVERCURRENT;
+    }
+}
+
+/* TMR1周期ごとの監視, ampは出力振幅(0-255), stepは検出位相が追従すべき位相(1/24周期単位) */
+inline void
+fault_check(unsigned char amp, char step) {
+    /* 逆転 */
+    if (step24_phase_error >= FAULT_REVERSE_COUNT) {
+        fault_flags |= FAULT_REVERSE;
+    }
+    step24_phase_error = 0;
+
+    /* 脱調 */
+    if (amp >= FAULT_STALL_AMP && velocity_value < FAULT_STALL_VELOCITY) {
+        if (++fault_stall_count >= FAULT_STALL_WINDOWS) {
+            fault_flags |= FAULT_STALL;
+        }
+    } else {
+        fault_stall_count = 0;
+    }
+
+    /* 同期外れ
+     * 相変化が途絶えると速度推定も下がるので, ずれ始めてからは速度によらず数え続ける */
+    if (velocity_value >= FAULT_SYNC_VELOCITY || fault_desync_count) {
+        char lag = step + 24 - step24_phase;
+        if (lag >= 24) {
+            lag -= 24;
+        }
+        /* -12～11に折り返して絶対値をとる */
+        if (lag >= 12) {
+            lag = 24 - lag;
+        }
+        if (lag > FAULT_LAG_MAX) {
+            if (++fault_desync_count >= FAULT_DESYNC_WINDOWS) {
+                fault_flags |= FAULT_DESYNC;
+            }
+        } else {
+            fault_desync_count = 0;
+        }
+    } else {
+        fault_desync_count = 0;
+    }
+
+    /* 振幅が0になってから一定時間待って復帰 */
+    if (fault_flags && 0 == fault_amp_limit) {
+        if (++fault_hold_count >= FAULT_HOLD_WINDOWS) {
+            fault_flags = 0;
+            fault_stall_count = 0;
+            fault_desync_count = 0;
+            fault_current_count = 0;
+            fault_hold_count = 0;
+            fault_amp_limit = 255;
+            fault_restart = 1;
+        }
+    }
+}
+
+/* 毎ループ呼び出して出力振幅を制限する
+ * 位置合わせ中のように回らないのが正常な間はenableを0にして監視を止める */
+inline unsigned char
+fault_update(unsigned char amp, char step, char enable) {
+    if (fault_window) {
+        fault_window = 0;
+        if (enable) {
+            fault_check(amp, step);
+        } else {
+            step24_phase_error = 0;
+            fault_stall_count = 0;
+            fault_desync_count = 0;
+        }
+    }
+    if (fault_flags && fault_amp_limit) {
+        fault_amp_limit -= (fault_amp_limit >> 2) + 1;
+    }
+    if (amp > fault_amp_limit) {
+        return fault_amp_limit;
+    }
+    return amp;
+}
+
+#endif /* __FAULT_H__ */
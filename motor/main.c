@@ -1,5 +1,27 @@
 #include "config.h"
 #include "step24.h"
+#include "step96.h"
+#include "velocity.h"
+#include "fault.h"
+#include "startup.h"
+
+/* 駆動方式(24: 8bit 24ステップ, 96: 10bit 96ステップ)
+ * 既定は従来の24ステップ, 96はビルド時に-DSTEP_MODE=96で選ぶ */
+#ifndef STEP_MODE
+#define STEP_MODE 24
+#endif
+
+/* 運転中の出力振幅(0-255)
+ * 24ステップではAMP_TO_STEP24でSTEP24_AMP_MAX(61, 従来の振幅)になる */
+#define MOTOR_AMP 255
+
+/* 電流検出に使うADCチャネル(未定義なら過電流検出なし)
+ * 使う場合はsetup()のANSELA/TRISAで該当ﾋﾟﾝをｱﾅﾛｸﾞ入力にすること */
+/* #define FAULT_CURRENT_CHS 3 */
+
+/* 1/96周期単位の指令位相をSTEP24_INDEXのステップに変換 */
+#define POS_TO_STEP24(pos) ((pos) / ((STEP96_STEP_MAX + 1) / (STEP24_STEP_MAX + 1)))
+#define AMP_TO_STEP24(amp) ((amp) >> 2 > STEP24_AMP_MAX ? STEP24_AMP_MAX : (amp) >> 2)
 
 void __interrupt()
 isr() {
@@ -7,6 +29,8 @@ isr() {
     if (TMR1IF) {
         DEBUG_CYCLE_TMR1;
         STEP24_SET_VELOCITY;
+        VELOCITY_SET_WINDOW;
+        FAULT_SET_WINDOW;
         TMR1_INIT;
     }
     GIE = 1;
@@ -16,8 +40,7 @@ void
 main(void) {
     setup();
 
-    char step = 0;
-    char ii = 0;
+    startup_init();
 
     while(1) {
         CHS0 = 0;            // AN0から読込む
@@ -31,19 +54,39 @@ main(void) {
         char adc_v = ADRESH;
 
         step24_set_phase(adc_u, adc_v);
+        velocity_update(step24_phase_diff);
 
-        step24_set_duty(61, step);
+#ifdef FAULT_CURRENT_CHS
+        ADCON0bits.CHS = FAULT_CURRENT_CHS;
+        GO_nDONE = 1;
+        while(GO_nDONE);
+        fault_current(ADRESH);
+        ADCON0bits.CHS = 0;
+#endif
+        if (fault_restart) {
+            fault_restart = 0;
+            startup_init();
+        }
+        startup_update(MOTOR_AMP);
+        unsigned char amp = fault_update(startup_amp, startup_phase(),
+            STARTUP_ALIGN != startup_state);
+
+#if STEP_MODE == 96
+        step96_set_duty(amp, startup_pos);
+        PWM1DCH = STEP96_DCH(step96_duty_u);
+        PWM1DCL = STEP96_DCL(step96_duty_u);
+        PWM2DCH = STEP96_DCH(step96_duty_v);
+        PWM2DCL = STEP96_DCL(step96_duty_v);
+        PWM3DCH = STEP96_DCH(step96_duty_w);
+        PWM3DCL = STEP96_DCL(step96_duty_w);
+#else
+        step24_set_duty(AMP_TO_STEP24(amp), POS_TO_STEP24(startup_pos));
         PWM1DCH = step24_duty_u;
         PWM2DCH = step24_duty_v;
         PWM3DCH = step24_duty_w;
+#endif
 
         DEBUG_CYCLE_SENS;
-        ii++;
-        if(ii>=200) {
-            ii = 0;
-            step++;
-            step %= 24;
-        }
     }
 
 }
@@ -0,0 +1,145 @@
+#ifndef __STARTUP_H__
+#define __STARTUP_H__
+
+/* 始動シーケンス
+ * 1. 位置合わせ: 位相0に固定して回転子を引き込む
+ * 2. 加速: TMR1の時刻で指令位相を進め, 間隔を少しずつ縮める(オープンループ)
+ * 3. 運転: 逆起電力の検出位相(step24_phase)が指令に追従したら検出位相基準に切り替える
+ * 加速が一定時間内に追従しなければ始動失敗(FAULT_START)として異常検出側で再始動させる
+ * 異常検出には, 加速中は指令位相, 運転中は相変化の間隔から予測した位相を渡す
+ * (運転中の指令位相は検出位相に従うので, 指令位相とのずれでは同期外れが分からない)
+ * 指令位相startup_posは1/96周期単位, 時間はTMR1H単位(64us) */
+
+#define STARTUP_ALIGN      0
+#define STARTUP_RAMP       1
+#define STARTUP_RUN        2
+
+#define STARTUP_ALIGN_AMP   96   /* 位置合わせの振幅(0-255) */
+#define STARTUP_ALIGN_TIME  3125 /* 位置合わせの時間(200ms) */
+#define STARTUP_RAMP_AMP    160  /* 加速中の振幅(0-255) */
+#define STARTUP_PERIOD_INIT (32 << 4) /* 1/96周期あたりの初期間隔(Q4, 2ms) */
+#define STARTUP_PERIOD_MIN  (2 << 4)  /* 加速の上限(Q4, 128us) */
+#define STARTUP_ACCEL_SHIFT 6    /* 1/96周期ごとに間隔を1/64縮める */
+#define STARTUP_LOCK_LAG    3    /* 指令位相と検出位相のずれの許容値(1/24周期単位) */
+#define STARTUP_LOCK_COUNT  24   /* 連続して追従した相変化の回数 */
+#define STARTUP_LEAD        6    /* 運転中の検出位相に対する指令位相の進み(1/24周期単位) */
+#define STARTUP_LOCK_TIMEOUT (STARTUP_ALIGN_TIME + 15625) /* 始動から追従までの上限(位置合わせ+1s) */
+#define STARTUP_PREDICT_MAX 11   /* 予測位相を検出位相より進める上限(1/24周期単位, 半周期未満) */
+
+/******************************************************************************/
+char startup_state = STARTUP_ALIGN;
+unsigned char startup_pos = 0;
+unsigned char startup_amp = 0;
+unsigned short startup_period = STARTUP_PERIOD_INIT;
+unsigned short startup_step_time = 0;
+unsigned short startup_begin_time = 0;
+unsigned short startup_lock_time = 0; /* 始動から運転に切り替わるまでの時間 */
+char startup_lock_count = 0;
+unsigned char startup_predict = 0;       /* 運転中の予測位相(1/24周期単位) */
+unsigned char startup_predict_lead = 0;  /* 予測位相の検出位相からの進み */
+unsigned short startup_predict_time = 0; /* 予測位相を最後に進めた時刻 */
+
+/******************************************************************************/
+inline void
+startup_init() {
+    startup_state = STARTUP_ALIGN;
+    startup_pos = 0;
+    startup_period = STARTUP_PERIOD_INIT;
+    startup_lock_count = 0;
+    startup_predict = 0;
+    startup_predict_lead = 0;
+    startup_begin_time = velocity_time();
+    startup_step_time = startup_begin_time;
+}
+
+/* 指令位相(1/24周期単位)と検出位相のずれ(-12～11) */
+inline signed char
+startup_lag(char step) {
+    char lag = step + 24 - step24_phase;
+    if (lag >= 24) {
+        lag -= 24;
+    }
+    return lag >= 12 ? lag - 24 : lag;
+}
+
+/* 毎ループ呼び出して指令位相と振幅を更新する, ampは運転中の振幅(0-255) */
+inline void
+startup_update(unsigned char amp) {
+    unsigned short now = velocity_time();
+    switch (startup_state) {
+    case STARTUP_ALIGN:
+        startup_amp = STARTUP_ALIGN_AMP;
+        if (now - startup_begin_time >= STARTUP_ALIGN_TIME) {
+            startup_state = STARTUP_RAMP;
+            startup_step_time = now;
+        }
+        break;
+    case STARTUP_RAMP:
+        startup_amp = STARTUP_RAMP_AMP;
+        if ((now - startup_step_time) << 4 >= startup_period) {
+            startup_step_time = now;
+            if (++startup_pos > STEP96_STEP_MAX) {
+                startup_pos = 0;
+            }
+            if (startup_period > STARTUP_PERIOD_MIN) {
+                startup_period -= (startup_period >> STARTUP_ACCEL_SHIFT) + 1;
+            }
+        }
+        if (step24_phase_diff) {
+            /* 1ステップずつ前進し指令に近い位相で検出されたら追従とみなす */
+            signed char lag = startup_lag(startup_pos >> 2);
+            if (1 == step24_phase_diff && lag <= STARTUP_LOCK_LAG && lag >= -STARTUP_LOCK_LAG) {
+                if (++startup_lock_count >= STARTUP_LOCK_COUNT) {
+                    startup_state = STARTUP_RUN;
+                    startup_lock_time = now - startup_begin_time;
+                }
+            } else {
+                startup_lock_count = 0;
+            }
+        }
+        if (STARTUP_RUN == startup_state) {
+            startup_predict = step24_phase;
+            startup_predict_lead = 0;
+            startup_predict_time = now;
+        } else if (now - startup_begin_time >= STARTUP_LOCK_TIMEOUT) {
+            fault_flags |= FAULT_START;
+        }
+        break;
+    default:
+        /* 検出位相から進めた位相を指令し, 相変化の間隔の1/4ごとに細分化する */
+        startup_amp = amp;
+        if (step24_phase_diff) {
+            char step = step24_phase + STARTUP_LEAD;
+            if (step >= 24) {
+                step -= 24;
+            }
+            startup_pos = step << 2;
+            startup_step_time = now;
+            startup_predict = step24_phase;
+            startup_predict_lead = 0;
+            startup_predict_time = now;
+        } else if (now - startup_step_time >= velocity_period >> 2
+            && (startup_pos & 3) != 3) {
+            startup_pos++;
+            startup_step_time = now;
+        }
+        /* 相変化が途絶えても直前の間隔で予測位相を進める(予測と検出のずれが滑り) */
+        if (startup_predict_lead < STARTUP_PREDICT_MAX
+            && now - startup_predict_time >= velocity_period) {
+            startup_predict_time += velocity_period ? velocity_period : 1;
+            startup_predict_lead++;
+            if (++startup_predict >= 24) {
+                startup_predict = 0;
+            }
+        }
+        break;
+    }
+}
+
+/* 同期外れの監視に使う位相(1/24周期単位) */
+inline char
+startup_phase() {
+    return STARTUP_RUN == startup_state ? startup_predict : startup_pos >> 2;
+}
+
+#endif /* __STARTUP_H__ */
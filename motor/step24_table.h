@@ -0,0 +1,114 @@
+#ifndef __STEP24_TABLE_H__
+#define __STEP24_TABLE_H__
+
+/* tools/step24_gen.c で生成 (-s 24 -a 62 -n 8 -p 127 -c 128 -w thi -o 30) */
+#define STEP24_GEN_STEPS    24
+#define STEP24_GEN_PEAK_MIN 8
+#define STEP24_GEN_PEAK_MAX 127
+#define STEP24_GEN_WAVE     0
+#define STEP24_GEN_OFFSET   30
+
+#define STEP24_STEP_MAX     23
+#define STEP24_INDEX_STRIDE 2
+#define STEP24_INDEX_BITS   4
+#define STEP24_INDEX_MASK   0xF
+#define STEP24_AMP_SHIFT    2
+#define STEP24_AMP_MAX      61
+#define STEP24_VALUE_MASK   0x3
+#define STEP24_VALUE_MINUS  0x4
+#define STEP24_VALUE_ZERO   0x8
+#define STEP24_CENTER       128
+
+/******************************************************************************/
+const char STEP24_VALUE[248] = {
+	0, 0, 0, 0,
+	3, 6, 7, 8,
+	4, 7, 9, 10,
+	5, 9, 11, 12,
+	6, 10, 13, 14,
+	7, 12, 15, 16,
+	7, 13, 17, 18,
+	8, 15, 19, 20,
+	9, 16, 20, 22,
+	10, 18, 22, 24,
+	11, 19, 24, 26,
+	11, 21, 26, 28,
+	12, 22, 28, 30,
+	13, 23, 30, 32,
+	14, 25, 32, 34,
+	15, 26, 33, 36,
+	16, 28, 35, 38,
+	16, 29, 37, 40,
+	17, 31, 39, 42,
+	18, 32, 41, 44,
+	19, 34, 43, 46,
+	20, 35, 45, 48,
+	20, 37, 46, 50,
+	21, 38, 48, 52,
+	22, 40, 50, 54,
+	23, 41, 52, 56,
+	24, 42, 54, 58,
+	25, 44, 56, 60,
+	25, 45, 58, 62,
+	26, 47, 59, 64,
+	27, 48, 61, 66,
+	28, 50, 63, 68,
+	28, 51, 64, 69,
+	29, 52, 66, 71,
+	30, 53, 68, 73,
+	31, 55, 70, 75,
+	32, 56, 72, 77,
+	32, 58, 73, 79,
+	33, 59, 75, 81,
+	34, 61, 77, 83,
+	35, 62, 79, 85,
+	36, 64, 81, 87,
+	36, 65, 83, 89,
+	37, 67, 85, 91,
+	38, 68, 86, 93,
+	39, 70, 88, 95,
+	40, 71, 90, 97,
+	41, 72, 92, 99,
+	41, 74, 94, 101,
+	42, 75, 96, 103,
+	43, 77, 98, 105,
+	44, 78, 99, 107,
+	45, 80, 101, 109,
+	45, 81, 103, 111,
+	46, 83, 105, 113,
+	47, 84, 107, 115,
+	48, 86, 109, 117,
+	49, 87, 111, 119,
+	50, 89, 112, 121,
+	50, 90, 114, 123,
+	51, 92, 116, 125,
+	52, 93, 118, 127
+};
+const char STEP24_INDEX[48] = {
+    0x1, 0x71,
+    0x2, 0x70,
+    0x3, 0x78,
+    0x3, 0x64,
+    0x3, 0x55,
+    0x3, 0x46,
+    0x3, 0x87,
+    0x2, 0x07,
+    0x1, 0x17,
+    0x0, 0x27,
+    0x8, 0x37,
+    0x4, 0x36,
+    0x5, 0x35,
+    0x6, 0x34,
+    0x7, 0x38,
+    0x7, 0x20,
+    0x7, 0x11,
+    0x7, 0x02,
+    0x7, 0x83,
+    0x6, 0x43,
+    0x5, 0x53,
+    0x4, 0x63,
+    0x8, 0x73,
+    0x0, 0x72
+};
+
+#endif /* __STEP24_TABLE_H__ */
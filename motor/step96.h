@@ -0,0 +1,90 @@
+#ifndef __STEP96_H__
+#define __STEP96_H__
+
+/* 1周期96ステップ, 10bitデューティの正弦波駆動
+ * 波形は1/4周期分(0°～90°)のテーブルだけを持ち, 残りは対称性から求める
+ * テーブル値は波形の最大値を255に正規化したもの
+ * フラッシュ使用量はテーブル25ワード(STEP24_VALUE+STEP24_INDEXは296ワード) */
+
+#define STEP96_STEP_MAX     95
+#define STEP96_QUARTER      24
+#define STEP96_PHASE_OFFSET 8   /* step=0でu相が30°になるようにずらす(step24と同じ位相) */
+#define STEP96_PHASE_V      32  /* v相はu相より120°進み, w相はさらに120°進み */
+#define STEP96_AMP_MAX      255
+#define STEP96_CENTER       512
+
+/******************************************************************************/
+#ifdef STEP96_WAVE_SVPWM
+/* 空間ベクトル変調(sinθ - (max + min)/2) */
+const unsigned char STEP96_VALUE[STEP96_QUARTER + 1] = {
+	0, 29, 58, 86, 114, 142, 169, 195,
+	221, 229, 236, 241, 246, 250, 253, 254,
+	255, 254, 253, 250, 246, 241, 236, 229,
+	221
+};
+#else
+/* 3次高調波注入(sinθ + (1 - √3/2)sin3θ), step24と同じ台形に近い波形 */
+const unsigned char STEP96_VALUE[STEP96_QUARTER + 1] = {
+	0, 27, 53, 79, 103, 126, 148, 168,
+	185, 201, 214, 225, 234, 241, 247, 251,
+	253, 254, 255, 255, 255, 254, 254, 253,
+	253
+};
+#endif
+
+/******************************************************************************/
+unsigned short step96_duty_u = STEP96_CENTER;
+unsigned short step96_duty_v = STEP96_CENTER;
+unsigned short step96_duty_w = STEP96_CENTER;
+
+/******************************************************************************/
+/* 位相pos(0～95, 0°起点)のデューティ(10bit)を返す
+ * 3相で呼ぶのでインライン展開せず1つだけ置く(フラッシュの節約) */
+unsigned short
+step96_value(unsigned char amp, unsigned char pos) {
+    unsigned char quadrant = 0;
+    while (pos >= STEP96_QUARTER) {
+        pos -= STEP96_QUARTER;
+        quadrant++;
+    }
+    /* 90°～180°, 270°～360°は折り返す */
+    if (quadrant & 1) {
+        pos = STEP96_QUARTER - pos;
+    }
+    /* 8bit×8bitを右に7bitシフトして最大±508 */
+    unsigned short value = (unsigned short)STEP96_VALUE[pos] * amp;
+    value >>= 7;
+    /* 180°～360°は負 */
+    if (quadrant & 2) {
+        return STEP96_CENTER - value;
+    } else {
+        return STEP96_CENTER + value;
+    }
+}
+
+inline void
+step96_set_duty(unsigned char amp, unsigned char step) {
+    unsigned char pos = step + STEP96_PHASE_OFFSET;
+    if (pos > STEP96_STEP_MAX) {
+        pos -= STEP96_STEP_MAX + 1;
+    }
+    step96_duty_u = step96_value(amp, pos);
+
+    pos += STEP96_PHASE_V;
+    if (pos > STEP96_STEP_MAX) {
+        pos -= STEP96_STEP_MAX + 1;
+    }
+    step96_duty_v = step96_value(amp, pos);
+
+    pos += STEP96_PHASE_V;
+    if (pos > STEP96_STEP_MAX) {
+        pos -= STEP96_STEP_MAX + 1;
+    }
+    step96_duty_w = step96_value(amp, pos);
+}
+
+/* PWMxDCH(上位8bit)とPWMxDCL(<7:6>に下位2bit)に分けて書き込む */
+#define STEP96_DCH(duty) ((unsigned char)((duty) >> 2))
+#define STEP96_DCL(duty) ((unsigned char)((duty) << 6))
+
+#endif /* __STEP96_H__ */
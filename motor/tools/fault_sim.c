@@ -0,0 +1,166 @@
+/* fault.h の異常注入シミュレーション(ホスト側で実行する)
+ *
+ * 位相検出と速度推定の結果(step24_phase, step24_phase_error, velocity_value)と
+ * 電流検出ADC値を直接与えて, 脱調, 同期外れ, 逆転, 過電流を起こし
+ *   1. 期待した監視周期の数で異常フラグが立つ
+ *   2. 振幅の上限が20ループ以内に0まで下がる
+ *   3. 振幅0からFAULT_HOLD_WINDOWS周期後にフラグが消えてfault_restartが立ち, 上限が255に戻る
+ * を確かめる. 正常な運転と監視を止めた状態(enable=0)では異常にならないことも確かめる
+ *
+ * ビルドと実行:
+ *   cc -O2 -funsigned-char -fgnu89-inline -I. -o fault_sim tools/fault_sim.c
+ *   ./fault_sim
+ */
+#include <stdio.h>
+
+char step24_phase = 0;
+char step24_phase_error = 0;
+unsigned short velocity_value = 0;
+#include "fault.h"
+
+#define LOOPS_PER_WINDOW 64 /* TMR1周期(8.192ms)あたりのメインループの回数 */
+#define AMP              200
+
+static int fail = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("FAIL: " __VA_ARGS__); \
+        printf("\n"); \
+        fail = 1; \
+    } \
+} while (0)
+
+static void
+reset() {
+    fault_flags = 0;
+    fault_amp_limit = 255;
+    fault_restart = 0;
+    fault_window = 0;
+    fault_stall_count = 0;
+    fault_desync_count = 0;
+    fault_current_count = 0;
+    fault_hold_count = 0;
+    step24_phase = 0;
+    step24_phase_error = 0;
+    velocity_value = 0;
+}
+
+/* 異常の状態 */
+#define INJECT_NONE        0
+#define INJECT_STALL       1
+#define INJECT_DESYNC      2
+#define INJECT_REVERSE     3
+#define INJECT_OVERCURRENT 4
+
+/* 1ループ分の入力を作る(stepは指令位相) */
+static char
+inject(int kind, long loop) {
+    char step = (char)((loop / 8) % 24);
+    step24_phase = step;
+    velocity_value = 64;
+    switch (kind) {
+    case INJECT_STALL:
+        velocity_value = 0;
+        break;
+    case INJECT_DESYNC:
+        step24_phase = (char)((step + 24 - (FAULT_LAG_MAX + 2)) % 24);
+        break;
+    case INJECT_REVERSE:
+        if (0 == loop % (LOOPS_PER_WINDOW / FAULT_REVERSE_COUNT)) {
+            step24_phase_error++;
+        }
+        break;
+    case INJECT_OVERCURRENT:
+        fault_current(FAULT_CURRENT_LIMIT + 10);
+        break;
+    default:
+        fault_current(FAULT_CURRENT_LIMIT - 10);
+        break;
+    }
+    return step;
+}
+
+/* 異常を注入して, フラグ, 振幅の絞り込み, 待ち, 復帰の順に進むことを確かめる
+ * windows_max: フラグが立つまでの監視周期の上限 */
+static void
+scenario(const char *name, int kind, char flag, int windows_max) {
+    reset();
+    long loop;
+    long flag_loop = -1, zero_loop = -1, restart_loop = -1;
+    for (loop = 0; loop < 400L * LOOPS_PER_WINDOW; loop++) {
+        if (0 == loop % LOOPS_PER_WINDOW) {
+            FAULT_SET_WINDOW;
+        }
+        char step = inject(restart_loop < 0 ? kind : INJECT_NONE, loop);
+        unsigned char amp = fault_update(AMP, step, 1);
+        if (flag_loop < 0 && fault_flags) {
+            flag_loop = loop;
+            CHECK(fault_flags & flag, "%s: raised %#x instead of %#x", name, fault_flags, flag);
+        }
+        if (flag_loop >= 0 && zero_loop < 0 && 0 == amp) {
+            zero_loop = loop;
+        }
+        if (zero_loop >= 0 && amp && !fault_restart) {
+            CHECK(0, "%s: output came back before the restart", name);
+        }
+        if (fault_restart) {
+            restart_loop = loop;
+            fault_restart = 0;
+            CHECK(0 == fault_flags, "%s: flags %#x left after the restart", name, fault_flags);
+            CHECK(255 == fault_amp_limit, "%s: limit %d after the restart", name, fault_amp_limit);
+            break;
+        }
+    }
+    CHECK(flag_loop >= 0, "%s: no fault raised", name);
+    CHECK(zero_loop >= 0, "%s: output never reached 0", name);
+    CHECK(restart_loop >= 0, "%s: no restart", name);
+    if (flag_loop < 0 || zero_loop < 0 || restart_loop < 0) {
+        return;
+    }
+    long windows = flag_loop / LOOPS_PER_WINDOW + 1;
+    long hold = (restart_loop - zero_loop + LOOPS_PER_WINDOW - 1) / LOOPS_PER_WINDOW;
+    printf("%-12s flag %#04x after %3ld windows, output 0 after %2ld loops, restart after %2ld windows\n",
+        name, flag, windows, zero_loop - flag_loop, hold);
+    CHECK(windows <= windows_max, "%s: raised after %ld windows (max %d)", name, windows, windows_max);
+    CHECK(zero_loop - flag_loop <= 20, "%s: took %ld loops to reach 0", name, zero_loop - flag_loop);
+    CHECK(hold >= FAULT_HOLD_WINDOWS && hold <= FAULT_HOLD_WINDOWS + 1,
+        "%s: held for %ld windows (expected %d)", name, hold, FAULT_HOLD_WINDOWS);
+}
+
+/* 正常な運転と, 監視を止めた状態では異常にならない */
+static void
+no_fault(const char *name, int kind, char enable) {
+    reset();
+    long loop;
+    for (loop = 0; loop < 400L * LOOPS_PER_WINDOW; loop++) {
+        if (0 == loop % LOOPS_PER_WINDOW) {
+            FAULT_SET_WINDOW;
+        }
+        char step = inject(kind, loop);
+        if (INJECT_OVERCURRENT == kind) {
+            /* 過電流は監視周期と関係なく検出するので, 止めた状態の確認から外す */
+            fault_current_count = 0;
+        }
+        unsigned char amp = fault_update(AMP, step, enable);
+        if (fault_flags || amp != AMP) {
+            break;
+        }
+    }
+    CHECK(0 == fault_flags, "%s: raised %#x", name, fault_flags);
+    printf("%-12s no fault over 400 windows\n", name);
+}
+
+int
+main() {
+    scenario("stall", INJECT_STALL, FAULT_STALL, FAULT_STALL_WINDOWS);
+    scenario("desync", INJECT_DESYNC, FAULT_DESYNC, FAULT_DESYNC_WINDOWS);
+    scenario("reverse", INJECT_REVERSE, FAULT_REVERSE, 2);
+    scenario("overcurrent", INJECT_OVERCURRENT, FAULT_OVERCURRENT, 1);
+    no_fault("running", INJECT_NONE, 1);
+    no_fault("off, stall", INJECT_STALL, 0);
+    no_fault("off, desync", INJECT_DESYNC, 0);
+    no_fault("off, reverse", INJECT_REVERSE, 0);
+    printf(fail ? "FAILED\n" : "ok\n");
+    return fail;
+}
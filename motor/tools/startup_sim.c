@@ -0,0 +1,175 @@
+/* startup.h の始動シミュレーション(ホスト側で実行する)
+ *
+ * TMR1(TMR1H単位64us, 周期8.192ms)とメインループ(32us)を模擬し, 回転子を
+ *   位置合わせ中は止まったまま, 加速中は指令位相に引き込まれ, 運転中は慣性で回る
+ * ものとして逆起電力の検出位相を作り, main.cと同じ順に
+ * velocity_update, startup_update, fault_update を呼ぶ. 次を確かめる
+ *   normal: 位置合わせがSTARTUP_ALIGN_TIMEで終わり, STARTUP_LOCK_TIMEOUT内に運転に切り替わり,
+ *           その後2秒間異常にならない(始動から運転までの時間を表示する)
+ *   lost:   運転中に相変化が途絶えるとFAULT_DESYNCになる(脱調より先に)
+ *   nolock: 検出位相が指令に追従しなければSTARTUP_LOCK_TIMEOUTでFAULT_STARTになり,
+ *           振幅を0にして待ったあと位置合わせからやり直す
+ *
+ * ビルドと実行:
+ *   cc -O2 -funsigned-char -fgnu89-inline -I. -o startup_sim tools/startup_sim.c
+ *   ./startup_sim
+ */
+#include <stdio.h>
+
+volatile unsigned char GIE;
+volatile unsigned char TMR1H;
+#include "step24.h"
+#include "step96.h"
+#include "velocity.h"
+#include "fault.h"
+#include "startup.h"
+
+#define SUBTICKS    256 /* TMR1L単位 */
+#define WINDOW      (VELOCITY_WINDOW_TICKS * SUBTICKS)
+#define LOOP_PERIOD 128 /* メインループの周期(TMR1L単位, 32us) */
+#define RUN_PERIOD  (8 * SUBTICKS) /* 運転中の相変化の間隔(加速の上限と同じ512us) */
+#define MS(t)       ((t) * 0.064 / SUBTICKS)
+
+#define SIM_NORMAL 0
+#define SIM_LOST   1
+#define SIM_NOLOCK 2
+
+static int fail = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("FAIL: " __VA_ARGS__); \
+        printf("\n"); \
+        fail = 1; \
+    } \
+} while (0)
+
+struct result {
+    long align_end;  /* 加速に切り替わった時刻 */
+    long lock;       /* 運転に切り替わった時刻 */
+    long fault;      /* 最初の異常の時刻 */
+    char flags;
+    long restart;    /* 異常から復帰して始動し直した時刻 */
+};
+
+static void
+init() {
+    velocity_time_base = 0;
+    velocity_phase_time = 0;
+    velocity_period = 0xFFFF;
+    velocity_value = 0;
+    velocity_window = 0;
+    step24_phase = 0;
+    step24_phase_diff = 0;
+    step24_phase_error = 0;
+    step24_phase_sum = 0;
+    step24_velocity = 0;
+    fault_flags = 0;
+    fault_amp_limit = 255;
+    fault_restart = 0;
+    fault_window = 0;
+    fault_stall_count = 0;
+    fault_desync_count = 0;
+    fault_current_count = 0;
+    fault_hold_count = 0;
+    TMR1H = 128;
+    startup_init();
+}
+
+static struct result
+run(int mode, long duration) {
+    struct result r = { -1, -1, -1, 0, -1 };
+    long t;
+    long last = 0;
+    init();
+    for (t = LOOP_PERIOD; t < duration; t += LOOP_PERIOD) {
+        if (0 == t % WINDOW) {
+            /* TMR1の割込み */
+            STEP24_SET_VELOCITY;
+            VELOCITY_SET_WINDOW;
+            FAULT_SET_WINDOW;
+        }
+        TMR1H = 128 + (t % WINDOW) / SUBTICKS;
+
+        /* 回転子 */
+        char diff = 0;
+        if (STARTUP_RAMP == startup_state && r.fault < 0) {
+            char target = startup_pos >> 2;
+            if (SIM_NOLOCK == mode) {
+                /* 引き込まれるが大きく遅れたまま */
+                target = (target + 24 - 5) % 24;
+            }
+            if (target != step24_phase) {
+                diff = 1;
+            }
+        } else if (STARTUP_RUN == startup_state) {
+            int lost = SIM_LOST == mode && t - r.lock > 500L * WINDOW / 8;
+            if (!lost && t - last >= RUN_PERIOD) {
+                diff = 1;
+            }
+        }
+        if (diff) {
+            step24_phase = (step24_phase + 1) % 24;
+            last = t;
+        }
+        step24_phase_diff = diff;
+        step24_phase_sum += diff;
+
+        /* main.cと同じ順 */
+        velocity_update(step24_phase_diff);
+        if (fault_restart) {
+            fault_restart = 0;
+            r.restart = t;
+            startup_init();
+            break;
+        }
+        char state = startup_state;
+        startup_update(255);
+        if (STARTUP_ALIGN == state && STARTUP_RAMP == startup_state && r.align_end < 0) {
+            r.align_end = t;
+        }
+        if (STARTUP_RUN == startup_state && r.lock < 0) {
+            r.lock = t;
+        }
+        fault_update(startup_amp, startup_phase(), STARTUP_ALIGN != startup_state);
+        if (fault_flags && r.fault < 0) {
+            r.fault = t;
+            r.flags = fault_flags;
+        }
+    }
+    return r;
+}
+
+int
+main() {
+    const long align = (long)STARTUP_ALIGN_TIME * SUBTICKS;
+    const long timeout = (long)STARTUP_LOCK_TIMEOUT * SUBTICKS;
+    struct result r;
+
+    r = run(SIM_NORMAL, timeout + 250L * WINDOW);
+    printf("normal  align %.1f ms, lock %.1f ms after start (%.1f ms of ramp)\n",
+        MS(r.align_end), MS(r.lock), MS(r.lock - r.align_end));
+    CHECK(r.align_end >= align && r.align_end <= align + 2 * SUBTICKS,
+        "normal: align ended at %.1f ms", MS(r.align_end));
+    CHECK(r.lock > 0 && r.lock < timeout, "normal: no lock before the timeout");
+    CHECK(r.fault < 0, "normal: fault %#x at %.1f ms", r.flags, MS(r.fault));
+
+    r = run(SIM_LOST, timeout + 250L * WINDOW);
+    long loss = r.lock + 500L * WINDOW / 8;
+    printf("lost    fault %#04x %.1f ms after the phase changes stopped\n", r.flags, MS(r.fault - loss));
+    CHECK(r.fault > loss, "lost: no fault after the loss");
+    CHECK(r.flags & FAULT_DESYNC, "lost: raised %#x instead of desync", r.flags);
+    CHECK(MS(r.fault - loss) < 100, "lost: desync took %.1f ms", MS(r.fault - loss));
+
+    r = run(SIM_NOLOCK, timeout + 250L * WINDOW);
+    printf("nolock  fault %#04x at %.1f ms, restart at %.1f ms\n", r.flags, MS(r.fault), MS(r.restart));
+    CHECK(r.lock < 0, "nolock: locked at %.1f ms", MS(r.lock));
+    CHECK(r.flags & FAULT_START, "nolock: raised %#x instead of start", r.flags);
+    CHECK(r.fault >= timeout && r.fault <= timeout + WINDOW,
+        "nolock: timeout at %.1f ms (expected %.1f ms)", MS(r.fault), MS(timeout));
+    CHECK(r.restart > r.fault, "nolock: no restart");
+    CHECK(STARTUP_ALIGN == startup_state, "nolock: restart did not align again");
+
+    printf(fail ? "FAILED\n" : "ok\n");
+    return fail;
+}
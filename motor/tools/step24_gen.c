@@ -0,0 +1,312 @@
+/* step24_table.h 生成ツール(ホスト側で実行する)
+ *
+ * 波形パラメータからSTEP24_VALUEとSTEP24_INDEXを生成して標準出力に書き出す
+ *
+ * ビルド:
+ *   cc -O2 -o step24_gen tools/step24_gen.c -lm
+ * 生成:
+ *   ./step24_gen -s 24 -a 62 -n 8 -p 127 -c 128 -w thi -o 30 > step24_table.h
+ * 検証(step24_table.hをstep24_set_dutyで復号して理想波形と比較する):
+ *   cc -O2 -funsigned-char -fgnu89-inline -DSTEP24_GEN_VERIFY -I. -o step24_verify tools/step24_gen.c -lm
+ *   ./step24_verify
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define WAVE_THI   0 /* 3次高調波注入(60°～120°で平坦) */
+#define WAVE_SIN   1 /* 正弦波 */
+#define WAVE_SVPWM 2 /* 空間ベクトル変調 */
+
+#define GEN_MAX_STEPS  96
+#define GEN_MAX_LEVELS 16
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef struct {
+    int steps;      /* 1周期のステップ数 */
+    int amp_levels; /* 振幅の段階数(0を含む) */
+    int peak_min;   /* 振幅1の波高値 */
+    int peak_max;   /* 振幅最大の波高値 */
+    int center;     /* 中性点のデューティ */
+    int wave;       /* 波形 */
+    int offset;     /* step=0のu相の位相(度) */
+} GEN_PARAM;
+
+typedef struct {
+    int level_count;
+    int levels[GEN_MAX_LEVELS];          /* 振幅最大の時の各波高値(昇順) */
+    int value_bits;
+    int stride;
+    unsigned char index[GEN_MAX_STEPS][3]; /* u,v,w相の値インデックス+符号/ゼロフラグ */
+} GEN_TABLE;
+
+/* 位相t(rad)の波形値, 波高値で正規化して-1～1 */
+static double
+gen_wave(int wave, double t) {
+    double u, v, w, max, min;
+    switch (wave) {
+    case WAVE_SIN:
+        return sin(t);
+    case WAVE_SVPWM:
+        u = sin(t);
+        v = sin(t - 2*M_PI/3);
+        w = sin(t + 2*M_PI/3);
+        max = u > v ? u : v;
+        max = max > w ? max : w;
+        min = u < v ? u : v;
+        min = min < w ? min : w;
+        return (u - (max + min)/2) / (sqrt(3)/2);
+    default:
+        u = (sin(t) + (1 - sqrt(3)/2)*sin(3*t)) / (sqrt(3)/2);
+        /* 75°付近の0.6%の膨らみは切り捨てる */
+        if (u > 1) {
+            return 1;
+        }
+        if (u < -1) {
+            return -1;
+        }
+        return u;
+    }
+}
+
+/* 相phase(0:u, 1:v, 2:w)のstepでの位相(rad), v相はu相より120°進み */
+static double
+gen_phase(const GEN_PARAM *p, int step, int phase) {
+    return (p->offset + 360.0*step/p->steps + 120.0*phase) * M_PI / 180;
+}
+
+/* 振幅ampの波高値 */
+static int
+gen_peak(const GEN_PARAM *p, int amp) {
+    if (0 == amp) {
+        return 0;
+    }
+    return (int)floor(p->peak_min + (double)(amp - 1)*(p->peak_max - p->peak_min)/(p->amp_levels - 2) + 0.5);
+}
+
+#ifdef STEP24_GEN_VERIFY
+#include "step24.h"
+
+/* 理想波形を量子化したデューティ */
+static int
+gen_ideal(const GEN_PARAM *p, int amp, int step, int phase) {
+    double f = gen_wave(p->wave, gen_phase(p, step, phase));
+    int level = (int)floor(fabs(f)*p->peak_max + 0.5);
+    int value = (int)floor((double)gen_peak(p, amp)*level/p->peak_max + 0.5);
+    return f < 0 ? p->center - value : p->center + value;
+}
+
+/* step24_table.hをstep24_set_dutyで復号して理想波形との差を調べる */
+int
+main(void) {
+    GEN_PARAM p;
+    int amp, step, phase;
+    int err_max = 0;
+    p.steps = STEP24_GEN_STEPS;
+    p.amp_levels = STEP24_AMP_MAX + 1;
+    p.peak_min = STEP24_GEN_PEAK_MIN;
+    p.peak_max = STEP24_GEN_PEAK_MAX;
+    p.center = STEP24_CENTER;
+    p.wave = STEP24_GEN_WAVE;
+    p.offset = STEP24_GEN_OFFSET;
+    for (amp = 0; amp <= STEP24_AMP_MAX; amp++) {
+        for (step = 0; step <= STEP24_STEP_MAX; step++) {
+            step24_set_duty(amp, step);
+            int duty[3] = { step24_duty_u, step24_duty_v, step24_duty_w };
+            for (phase = 0; phase < 3; phase++) {
+                int err = abs(duty[phase] - gen_ideal(&p, amp, step, phase));
+                if (err > err_max) {
+                    err_max = err;
+                }
+                if (err > 1) {
+                    printf("amp %d step %d phase %d: duty %d ideal %d\n",
+                        amp, step, phase, duty[phase], gen_ideal(&p, amp, step, phase));
+                }
+            }
+        }
+    }
+    printf("max error %d\n", err_max);
+    return err_max > 1;
+}
+#else
+static int
+gen_build(const GEN_PARAM *p, GEN_TABLE *t) {
+    int step, phase, i;
+    memset(t, 0, sizeof(*t));
+    /* 振幅最大の時に現れる波高値を集めて昇順に並べる */
+    for (step = 0; step < p->steps; step++) {
+        for (phase = 0; phase < 3; phase++) {
+            double f = gen_wave(p->wave, gen_phase(p, step, phase));
+            int level = (int)floor(fabs(f)*p->peak_max + 0.5);
+            if (0 == level) {
+                continue;
+            }
+            for (i = 0; i < t->level_count && t->levels[i] < level; i++);
+            if (i < t->level_count && t->levels[i] == level) {
+                continue;
+            }
+            if (t->level_count >= GEN_MAX_LEVELS) {
+                fprintf(stderr, "too many levels (max %d)\n", GEN_MAX_LEVELS);
+                return 0;
+            }
+            memmove(t->levels + i + 1, t->levels + i, sizeof(int)*(t->level_count - i));
+            t->levels[i] = level;
+            t->level_count++;
+        }
+    }
+    for (t->value_bits = 0; (1 << t->value_bits) < t->level_count; t->value_bits++);
+    if (0 == t->value_bits) {
+        t->value_bits = 1;
+    }
+    /* 符号/ゼロフラグ込みで4bitに収まればv相とw相を1byteに詰める */
+    t->stride = t->value_bits + 2 <= 4 ? 2 : 3;
+    if ((p->amp_levels << t->value_bits) > 256) {
+        fprintf(stderr, "STEP24_VALUE exceeds 256 bytes (%d levels x %d values)\n",
+            p->amp_levels, 1 << t->value_bits);
+        return 0;
+    }
+    if (p->steps * t->stride > 256) {
+        fprintf(stderr, "STEP24_INDEX exceeds 256 bytes (%d steps x %d bytes)\n",
+            p->steps, t->stride);
+        return 0;
+    }
+    for (step = 0; step < p->steps; step++) {
+        for (phase = 0; phase < 3; phase++) {
+            double f = gen_wave(p->wave, gen_phase(p, step, phase));
+            int level = (int)floor(fabs(f)*p->peak_max + 0.5);
+            unsigned char idx;
+            if (0 == level) {
+                idx = 1 << (t->value_bits + 1);
+            } else {
+                for (i = 0; t->levels[i] != level; i++);
+                idx = i;
+                if (f < 0) {
+                    idx |= 1 << t->value_bits;
+                }
+            }
+            t->index[step][phase] = idx;
+        }
+    }
+    return 1;
+}
+
+static void
+gen_print(const GEN_PARAM *p, const GEN_TABLE *t) {
+    static const char *WAVE_NAME[] = { "thi", "sin", "svpwm" };
+    int amp, step, i;
+    int values = 1 << t->value_bits;
+    printf("#ifndef __STEP24_TABLE_H__\n");
+    printf("#define __STEP24_TABLE_H__\n\n");
+    printf("/* tools/step24_gen.c で生成 (-s %d -a %d -n %d -p %d -c %d -w %s -o %d) */\n",
+        p->steps, p->amp_levels, p->peak_min, p->peak_max, p->center, WAVE_NAME[p->wave], p->offset);
+    printf("#define STEP24_GEN_STEPS    %d\n", p->steps);
+    printf("#define STEP24_GEN_PEAK_MIN %d\n", p->peak_min);
+    printf("#define STEP24_GEN_PEAK_MAX %d\n", p->peak_max);
+    printf("#define STEP24_GEN_WAVE     %d\n", p->wave);
+    printf("#define STEP24_GEN_OFFSET   %d\n\n", p->offset);
+    printf("#define STEP24_STEP_MAX     %d\n", p->steps - 1);
+    printf("#define STEP24_INDEX_STRIDE %d\n", t->stride);
+    printf("#define STEP24_INDEX_BITS   4\n");
+    printf("#define STEP24_INDEX_MASK   0xF\n");
+    printf("#define STEP24_AMP_SHIFT    %d\n", t->value_bits);
+    printf("#define STEP24_AMP_MAX      %d\n", p->amp_levels - 1);
+    printf("#define STEP24_VALUE_MASK   0x%X\n", values - 1);
+    printf("#define STEP24_VALUE_MINUS  0x%X\n", 1 << t->value_bits);
+    printf("#define STEP24_VALUE_ZERO   0x%X\n", 1 << (t->value_bits + 1));
+    printf("#define STEP24_CENTER       %d\n\n", p->center);
+    printf("/******************************************************************************/\n");
+    printf("const char STEP24_VALUE[%d] = {\n", p->amp_levels * values);
+    for (amp = 0; amp < p->amp_levels; amp++) {
+        int peak = gen_peak(p, amp);
+        printf("\t");
+        for (i = 0; i < values; i++) {
+            int value = 0;
+            if (i < t->level_count) {
+                value = (int)floor((double)peak*t->levels[i]/p->peak_max + 0.5);
+            }
+            printf("%d%s", value, i + 1 < values ? ", " : "");
+        }
+        printf("%s\n", amp + 1 < p->amp_levels ? "," : "");
+    }
+    printf("};\n");
+    printf("const char STEP24_INDEX[%d] = {\n", p->steps * t->stride);
+    for (step = 0; step < p->steps; step++) {
+        const unsigned char *idx = t->index[step];
+        const char *sep = step + 1 < p->steps ? "," : "";
+        if (2 == t->stride) {
+            printf("    0x%X, 0x%02X%s\n", idx[0], idx[1] | (idx[2] << 4), sep);
+        } else {
+            printf("    0x%X, 0x%X, 0x%X%s\n", idx[0], idx[1], idx[2], sep);
+        }
+    }
+    printf("};\n\n");
+    printf("#endif /* __STEP24_TABLE_H__ */\n");
+}
+
+static void
+usage(void) {
+    fprintf(stderr,
+        "usage: step24_gen [-s steps] [-a amp_levels] [-n peak_min] [-p peak_max]\n"
+        "                  [-c center] [-w thi|sin|svpwm] [-o offset_deg]\n");
+    exit(1);
+}
+
+int
+main(int argc, char *argv[]) {
+    GEN_PARAM p = { 24, 62, 8, 127, 128, WAVE_THI, 30 };
+    GEN_TABLE t;
+    int i;
+    for (i = 1; i + 1 < argc; i += 2) {
+        const char *val = argv[i + 1];
+        if (0 == strcmp("-s", argv[i])) {
+            p.steps = atoi(val);
+        } else if (0 == strcmp("-a", argv[i])) {
+            p.amp_levels = atoi(val);
+        } else if (0 == strcmp("-n", argv[i])) {
+            p.peak_min = atoi(val);
+        } else if (0 == strcmp("-p", argv[i])) {
+            p.peak_max = atoi(val);
+        } else if (0 == strcmp("-c", argv[i])) {
+            p.center = atoi(val);
+        } else if (0 == strcmp("-w", argv[i])) {
+            if (0 == strcmp("sin", val)) {
+                p.wave = WAVE_SIN;
+            } else if (0 == strcmp("svpwm", val)) {
+                p.wave = WAVE_SVPWM;
+            } else if (0 == strcmp("thi", val)) {
+                p.wave = WAVE_THI;
+            } else {
+                usage();
+            }
+        } else if (0 == strcmp("-o", argv[i])) {
+            p.offset = atoi(val);
+        } else {
+            usage();
+        }
+    }
+    if (i < argc) {
+        usage();
+    }
+    if (p.steps < 6 || p.steps > GEN_MAX_STEPS || p.steps % 6 != 0) {
+        fprintf(stderr, "steps must be a multiple of 6 up to %d\n", GEN_MAX_STEPS);
+        return 1;
+    }
+    if (p.amp_levels < 3 || p.peak_min < 1 || p.peak_min > p.peak_max) {
+        fprintf(stderr, "invalid amplitude range\n");
+        return 1;
+    }
+    if (p.center - p.peak_max < 0 || p.center + p.peak_max > 255) {
+        fprintf(stderr, "center +/- peak_max must fit in 0-255\n");
+        return 1;
+    }
+    if (!gen_build(&p, &t)) {
+        return 1;
+    }
+    gen_print(&p, &t);
+    return 0;
+}
+#endif
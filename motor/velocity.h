@@ -0,0 +1,75 @@
+#ifndef __VELOCITY_H__
+#define __VELOCITY_H__
+
+/* 速度推定
+ * 低速: 相変化の時刻をTMR1で測り, 相変化の間隔から求める
+ * 高速: TMR1周期(8.192ms)内の相変化数(step24_velocity)から求める
+ * velocity_valueはTMR1周期あたりの相変化数をVELOCITY_SHIFTだけ左シフトした値 */
+
+#define VELOCITY_SHIFT        4
+#define VELOCITY_WINDOW_TICKS 128 /* TMR1周期をTMR1H単位(64us)で数えた値 */
+#define VELOCITY_PERIOD_COUNT 4   /* TMR1周期内の相変化数がこれ未満なら間隔から求める */
+#define VELOCITY_FILTER_SHIFT 2   /* 平滑化の係数(1/4) */
+
+/******************************************************************************/
+unsigned short velocity_time_base = 0;  /* TMR1H単位(64us)の時刻, TMR1周期ごとに進める */
+unsigned short velocity_phase_time = 0; /* 直前の相変化の時刻 */
+unsigned short velocity_period = 0xFFFF;/* 直前の相変化の間隔 */
+unsigned short velocity_value = 0;
+char velocity_window = 0;
+
+/******************************************************************************/
+/* TMR1割込みで時刻を進める */
+#define VELOCITY_SET_WINDOW (velocity_time_base += VELOCITY_WINDOW_TICKS, velocity_window = 1)
+
+/* 現在時刻(TMR1H単位)
+ * TMR1はTMR1H=128から数えるので, オーバーフロー後で割込み前(TMR1H<128)なら
+ * (TMR1H - 128)の桁あふれがそのまま+128になる */
+inline unsigned short
+velocity_time() {
+    GIE = 0;
+    unsigned short now = velocity_time_base + (unsigned char)(TMR1H - 128);
+    GIE = 1;
+    return now;
+}
+
+inline void
+velocity_filter(unsigned short estimate) {
+    velocity_value -= velocity_value >> VELOCITY_FILTER_SHIFT;
+    velocity_value += estimate >> VELOCITY_FILTER_SHIFT;
+}
+
+/* 相変化数phase_diffを与えて速度を更新する */
+inline void
+velocity_update(char phase_diff) {
+    if (phase_diff) {
+        unsigned short now = velocity_time();
+        velocity_period = now - velocity_phase_time;
+        velocity_phase_time = now;
+        if (step24_velocity < VELOCITY_PERIOD_COUNT && velocity_period) {
+            /* 間隔から求める(TMR1周期あたりに換算) */
+            velocity_filter(((unsigned short)phase_diff
+                << (VELOCITY_SHIFT + 7)) / velocity_period);
+        }
+    }
+    if (!velocity_window) {
+        return;
+    }
+    velocity_window = 0;
+    if (step24_velocity < VELOCITY_PERIOD_COUNT) {
+        /* 相変化が途絶えたら経過時間を間隔の上限として減速させる */
+        unsigned short elapsed = velocity_time() - velocity_phase_time;
+        if (elapsed > velocity_period) {
+            if (elapsed & 0x8000) {
+                velocity_value = 0;
+            } else {
+                velocity_filter((1 << (VELOCITY_SHIFT + 7)) / elapsed);
+            }
+        }
+    } else {
+        /* 相変化数から求める */
+        velocity_filter(step24_velocity << VELOCITY_SHIFT);
+    }
+}
+
+#endif /* __VELOCITY_H__ */
@@ -0,0 +1,81 @@
+// 適応ゲイン(IMU_FILTER_T::set_adaptive)の再生テスト
+// 傾いて静止した機体を水平の姿勢から推定し始め, 加速度のノイズと
+// 周期的な横方向の運動加速度(4秒ごとに1秒)を加える
+// 各エンジンで適応ゲインなしとあり(setup()と同じ10倍, 2秒)を比べ
+//   converge: 誤差がCONVERGE_ANGLEを下回るまでの時間(s)
+//   steady:   STEADY以降の誤差の二乗平均(rad)
+// を表示する. 適応ゲインで収束が遅くなったり定常誤差が増えたら失敗にする
+#include <stdio.h>
+#include "imu_filter.h"
+#include "driver_motion.h"
+
+#define SAMPLE_RATE     600
+#define DURATION        20     // (s)
+#define STEADY          10     // 定常誤差を数え始める時間(s)
+#define CONVERGE_ANGLE  0.02f  // (rad)
+#define LATERAL_ACCEL   0.37f  // 運動加速度(g)
+#define STEADY_MARGIN   1.05f  // 定常誤差の増加の許容(倍)
+
+struct RESULT {
+	float converge;
+	float steady;
+};
+
+template <class ENGINE>
+static RESULT run(float gain, bool adaptive) {
+	IMU_FILTER_T<ENGINE> filter;
+	filter.set_sample_rate(SAMPLE_RATE);
+	filter.set_gres(MOTION_GRES);
+	filter.set_ascale(MOTION_ARES);
+	filter.set_gain(gain);
+	if (adaptive) {
+		filter.set_adaptive(10.0f, 2.0f);
+	}
+	MOTION motion;
+	const float axis[3] = { 0.6f, 0.8f, 0 };
+	motion.set_attitude(0.6f, axis);
+	motion.gyro_noise = 3;
+	motion.accel_noise = 800;
+	RESULT r = { -1, 0 };
+	double se = 0;
+	int n = 0;
+	for (int k = 0; k < DURATION * SAMPLE_RATE; k++) {
+		motion.accel_ext[0] = (k / SAMPLE_RATE) % 4 == 3 ? LATERAL_ACCEL : 0;
+		float g[3], a[3], m[3];
+		motion.sense(g, a, m);
+		filter.update(g[0], g[1], g[2], a[0], a[1], a[2], m[0], m[1], m[2]);
+		float q[4];
+		filter.get_quaternion(q);
+		float e = motion_angle(q, motion.q);
+		if (r.converge < 0 && e < CONVERGE_ANGLE) {
+			r.converge = (float)k / SAMPLE_RATE;
+		}
+		if (k >= STEADY * SAMPLE_RATE) {
+			se += e * e;
+			n++;
+		}
+	}
+	r.steady = sqrt(se / n);
+	return r;
+}
+
+template <class ENGINE>
+static bool compare(const char *name, float gain) {
+	RESULT fixed = run<ENGINE>(gain, false);
+	RESULT adapt = run<ENGINE>(gain, true);
+	// 収束しなかったら全体の時間とみなす
+	float cf = fixed.converge < 0 ? DURATION : fixed.converge;
+	float ca = adapt.converge < 0 ? DURATION : adapt.converge;
+	bool ok = adapt.converge >= 0 && ca <= cf && adapt.steady <= fixed.steady * STEADY_MARGIN;
+	printf("%-9s gain %.2f  converge %6.3f -> %6.3f s  steady %.4f -> %.4f rad  %s\n",
+		name, gain, cf, ca, fixed.steady, adapt.steady, ok ? "ok" : "FAIL");
+	return ok;
+}
+
+int main() {
+	bool ok = true;
+	ok &= compare<MADGWICK>("madgwick", 0.05f);
+	ok &= compare<MAHONY>("mahony", 0.5f);
+	ok &= compare<ESKF>("eskf", 0.5f);
+	return ok ? 0 : 1;
+}
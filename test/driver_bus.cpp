@@ -0,0 +1,107 @@
+// LSM9DS1のバスの異常の扱い(lsm9ds1.cpp)をシミュレーションしたセンサーで確かめる
+//   read/write: 読込みと書込みの失敗をbus_error()で数え, バス転送の計測を閉じる
+//   streak:     書込みの失敗が続いてもrecover()する
+//   stuck:      SDAを掴んだスレーブをSCLのクロックとSTOPで放し, 設定を書き戻す
+//   dead:       回復できないバスでrecover()が入れ子にならず, 失敗が続くたびに1回だけ行う
+#include <stdio.h>
+#include "Arduino.h"
+#include "Wire.h"
+#include "lsm9ds1.h"
+#include "instrument.h"
+#include "sim_lsm9ds1.h"
+
+static int fail = 0;
+
+static void check(const char *name, bool ok, const char *format, ...) {
+	char detail[160];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(detail, sizeof(detail), format, args);
+	va_end(args);
+	printf("%-7s %s  %s\n", name, detail, ok ? "ok" : "FAIL");
+	if (!ok) fail = 1;
+}
+
+// 制御レジスタ(CTRL_REG1_GからCTRL_REG10, CTRL_REG1_MからCTRL_REG5_M)
+struct IMAGE {
+	uint8_t ag[0x15];
+	uint8_t m[5];
+
+	void read(SIM_LSM9DS1 &sim) {
+		for (int i = 0; i < 0x15; i++) ag[i] = sim.get_ag(0x10 + i);
+		for (int i = 0; i < 5; i++) m[i] = sim.get_m(0x20 + i);
+	}
+	bool operator==(const IMAGE &o) const {
+		return 0 == memcmp(ag, o.ag, sizeof(ag)) && 0 == memcmp(m, o.m, sizeof(m));
+	}
+};
+
+int main() {
+	SIM_LSM9DS1 sim;
+	Wire.attach(&sim);
+	stub_pin = &sim;
+	Wire.begin(SDA, SCL, 400000);
+	LSM9DS1 imu;
+	uint16_t who = imu.begin(sim.addr_ag, sim.addr_m, Wire, SDA, SCL);
+	IMAGE image;
+	image.read(sim);
+	check("begin", 0x683D == who && 0 != image.ag[0], "who_am_i %04x ctrl_reg1_g %02x", who, image.ag[0]);
+	instrument.reset();
+
+	// 読込みの失敗
+	uint32_t errors = imu.error_count;
+	sim.fail(1);
+	imu.available_ag();
+	check("read", imu.error_count == errors + 1 && 1 == instrument.bus_count && 1 == instrument.i2c_error,
+		"errors +%u bus transfers %u", (unsigned)(imu.error_count - errors), (unsigned)instrument.bus_count);
+
+	// 書込みの失敗(読んで書き戻す)
+	instrument.reset();
+	errors = imu.error_count;
+	sim.fail(1, true);
+	imu.set_scale_g(imu.settings.gyro.scale);
+	check("write", imu.error_count == errors + 1 && 2 == instrument.bus_count && 1 == instrument.i2c_error,
+		"errors +%u bus transfers %u", (unsigned)(imu.error_count - errors), (unsigned)instrument.bus_count);
+
+	// 書込みの失敗が続いたら回復する
+	uint32_t recovers = imu.recover_count;
+	sim.fail(LSM9DS1_RECOVER_ERRORS, true);
+	for (int i = 0; i < LSM9DS1_RECOVER_ERRORS; i++) {
+		imu.offset_m(0, 0);
+	}
+	IMAGE after;
+	after.read(sim);
+	check("streak", imu.recover_count == recovers + 1 && after == image,
+		"recovers +%u settings %s", (unsigned)(imu.recover_count - recovers), after == image ? "restored" : "lost");
+
+	// SDAを掴んだスレーブ(設定も消えている)
+	recovers = imu.recover_count;
+	sim.power_on();
+	sim.stick(3);
+	for (int i = 0; i < LSM9DS1_RECOVER_ERRORS; i++) {
+		imu.read_g();
+	}
+	after.read(sim);
+	bool read = imu.read_g();
+	check("stuck", imu.recover_count == recovers + 1 && !sim.is_stuck() && Wire.is_running() && after == image && read,
+		"recovers +%u bus %s settings %s", (unsigned)(imu.recover_count - recovers),
+		sim.is_stuck() ? "stuck" : "released", after == image ? "restored" : "lost");
+
+	// 回復できないバス(SDAを放さない)
+	recovers = imu.recover_count;
+	errors = imu.error_count;
+	sim.stick(1000);
+	const int reads = 4 * LSM9DS1_RECOVER_ERRORS;
+	for (int i = 0; i < reads; i++) {
+		imu.read_g();
+	}
+	unsigned r = imu.recover_count - recovers;
+	check("dead", LSM9DS1_RECOVER_ERRORS * r <= (unsigned)reads && r >= 1 && imu.error_count - errors > (unsigned)reads,
+		"recovers +%u errors +%u for %d reads", r, (unsigned)(imu.error_count - errors), reads);
+
+	// 放したら戻る
+	sim.stick(0);
+	bool ok = imu.recover();
+	check("resume", ok && !sim.is_stuck() && imu.read_g(), "recover %s", ok ? "true" : "false");
+	return fail;
+}
@@ -0,0 +1,96 @@
+// 姿勢制御(flight_control.cpp)の閉ループの確認
+// 剛体(角加速度 = ミキサの逆変換 × CONTROL_AUTHORITY)の角速度をジャイロとして
+// IMU_FILTER(ジャイロだけ)で姿勢を積算し, FLIGHT_CONTROLで制御する
+//   sign:    ロール, ピッチ, 両方の目標角度に収束する(符号が逆なら発散する)
+//   latency: ジャイロがDELAY周期遅れても収束する(読込みの1周期の遅れ)
+//   kick:    リセット直後の最初の更新で微分が跳ねない
+#include <stdio.h>
+#include <math.h>
+#include "imu_filter.h"
+#include "flight_control.h"
+
+#define SAMPLE_RATE        600
+#define CONTROL_AUTHORITY  400.0f // 操作量1あたりの角加速度(rad/s^2)
+#define SETTLE_TIME        3.0f   // 収束を見るまでの時間(s)
+#define ANGLE_TOLERANCE    0.02f  // 収束の許容誤差(rad)
+#define DELAY_MAX          4
+
+static const float MIXER[MOTOR_COUNT][3] = {
+	{  1,  1, -1 },
+	{ -1,  1,  1 },
+	{ -1, -1, -1 },
+	{  1, -1,  1 },
+};
+
+// 目標(x, y)で動かして収束後のroll, pitchの誤差と途中の最大角度を返す
+static void run(float x, float y, int delay, float &error, float &peak) {
+	IMU_FILTER filter;
+	FLIGHT_CONTROL control;
+	filter.set_sample_rate(SAMPLE_RATE);
+	control.set_setpoint(x, y);
+	control.set_throttle(0.5f);
+	const float dt = 1.0f / SAMPLE_RATE;
+	float w[3] = { 0, 0, 0 };
+	float history[DELAY_MAX + 1][3] = {};
+	peak = 0;
+	for (int k = 0; k < SETTLE_TIME * SAMPLE_RATE; k++) {
+		// ジャイロの読込みの遅れ
+		for (int d = DELAY_MAX; d > 0; d--) {
+			for (int i = 0; i < 3; i++) history[d][i] = history[d - 1][i];
+		}
+		for (int i = 0; i < 3; i++) history[0][i] = w[i];
+		const float *g = history[delay];
+		filter.update(g[0], g[1], g[2], 0, 0, 0, 0, 0, 0, dt);
+		float q_heading[4], q_target[4], q_error[4];
+		filter.get_heading(q_heading);
+		control.compute_target(q_heading, q_target);
+		filter.compute_error(q_target, q_error);
+		float rate[3];
+		filter.get_rate(rate);
+		control.update(q_error, rate[0], rate[1], rate[2], dt);
+		// ミキサの逆変換で各軸の操作量に戻して剛体を動かす
+		for (int a = 0; a < 3; a++) {
+			float u = 0;
+			for (int i = 0; i < MOTOR_COUNT; i++) u += MIXER[i][a] * control.motor[i];
+			w[a] += CONTROL_AUTHORITY * u / MOTOR_COUNT * dt;
+		}
+		filter.compute_angles();
+		peak = fmaxf(peak, fmaxf(fabsf(filter.roll), fabsf(filter.pitch)));
+	}
+	filter.compute_angles();
+	error = fmaxf(fabsf(filter.roll - control.setpoint_roll), fabsf(filter.pitch - control.setpoint_pitch));
+}
+
+int main() {
+	int fail = 0;
+	static const struct { const char *name; float x, y; } CASES[] = {
+		{ "roll",  0.5f,  0    },
+		{ "pitch", 0,     0.5f },
+		{ "both", -0.4f,  0.6f },
+	};
+	for (int delay = 0; delay <= 1; delay++) {
+		for (auto &c : CASES) {
+			float error, peak;
+			run(c.x, c.y, delay, error, peak);
+			bool ok = error < ANGLE_TOLERANCE && peak < 1.5f;
+			printf("%-6s delay %d  error %.4f rad  peak %.3f rad  %s\n", c.name, delay, error, peak, ok ? "ok" : "FAIL");
+			if (!ok) fail = 1;
+		}
+	}
+
+	// リセット直後に一定の偏差を入れても最初の出力は比例と積分だけ
+	PID pid;
+	pid.kp = 0.05f;
+	pid.ki = 0.02f;
+	pid.kd = 0.001f;
+	pid.integral_limit = 1;
+	pid.reset();
+	const float dt = 1.0f / SAMPLE_RATE;
+	const float e = 1.0f;
+	float u = pid.update(e, dt);
+	float expected = pid.kp * e + pid.ki * e * dt;
+	bool ok = fabsf(u - expected) < 1e-6f;
+	printf("kick   first %.6f  expected %.6f  %s\n", u, expected, ok ? "ok" : "FAIL");
+	if (!ok) fail = 1;
+	return fail;
+}
@@ -0,0 +1,54 @@
+// LSM9DS1_FAULT_INJECT(lsm9ds1.cppの故障注入)が読込みと書込みの両方に効くことを確かめる
+// LSM9DS1_FAULT_INJECT=5でビルドし, 5回に1回の転送の失敗をbus_error()で数える
+// 書込みは再試行して全て届き, 起動(begin)も成功する
+#include <stdio.h>
+#include "Arduino.h"
+#include "Wire.h"
+#include "lsm9ds1.h"
+#include "sim_lsm9ds1.h"
+
+#define TRANSFERS (20 * LSM9DS1_FAULT_INJECT)
+
+int main() {
+	int fail = 0;
+	SIM_LSM9DS1 sim;
+	Wire.attach(&sim);
+	stub_pin = &sim;
+	Wire.begin(SDA, SCL, 400000);
+	LSM9DS1 imu;
+	// setup()と同じく応答しなければ回復して再試行する
+	int retry = 0;
+	for (; !imu.begin(sim.addr_ag, sim.addr_m, Wire, SDA, SCL); retry++) {
+		if (retry >= 10) {
+			printf("begin   no answer after %d retries  FAIL\n", retry);
+			return 1;
+		}
+		imu.recover();
+	}
+	printf("begin   %d retries\n", retry);
+
+	// 読込みは失敗した分だけ値を失う
+	uint32_t errors = imu.error_count;
+	for (int i = 0; i < TRANSFERS; i++) {
+		imu.read_g();
+	}
+	unsigned e = imu.error_count - errors;
+	bool ok = TRANSFERS / LSM9DS1_FAULT_INJECT == e;
+	printf("read    %u of %d transfers failed  %s\n", e, TRANSFERS, ok ? "ok" : "FAIL");
+	if (!ok) fail = 1;
+
+	// 書込みは失敗したら再試行するので全て届く
+	errors = imu.error_count;
+	int lost = 0;
+	for (int i = 0; i < TRANSFERS / 2; i++) {
+		imu.offset_m(0, i);
+		if (sim.get_m(0x05) != (uint8_t)i) {
+			lost++;
+		}
+	}
+	e = imu.error_count - errors;
+	ok = (TRANSFERS + e) / LSM9DS1_FAULT_INJECT == e && 0 == lost;
+	printf("write   %u of %u transfers failed, %d writes lost  %s\n", e, TRANSFERS + e, lost, ok ? "ok" : "FAIL");
+	if (!ok) fail = 1;
+	return fail;
+}
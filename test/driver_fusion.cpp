@@ -0,0 +1,109 @@
+// 姿勢推定エンジン(MADGWICK, MAHONY, ESKF)の比較
+// 同じ合成データ(driver_motion.h)を各エンジンの既定のゲインで処理して
+//   ram:      エンジンとIMU_FILTER_T<ENGINE>の大きさ(byte)
+//   time:     1回のupdateの時間(ホスト, ns)
+//   accuracy: 真の姿勢との誤差(rad, 二乗平均と最大)
+// を表示する. ESP32でのサイクル数はINSTRUMENT_ENABLEでビルドして"stats"のFILTERで測る
+// 誤差がACCURACY_MAXを超えたら失敗にする
+#include <stdio.h>
+#include <time.h>
+#include "imu_filter.h"
+#include "driver_motion.h"
+
+#define SAMPLE_RATE   600
+#define DURATION      30     // 合成データの長さ(s)
+#define SETTLE        5      // 誤差を数え始めるまでの時間(s)
+#define REPEAT        20     // 時間を測るときの繰り返し回数
+#define ACCURACY_MAX  0.02f  // 誤差の二乗平均の上限(rad)
+
+#define SAMPLES (DURATION * SAMPLE_RATE)
+
+struct LOG {
+	float g[SAMPLES][3];
+	float a[SAMPLES][3];
+	float m[SAMPLES][3];
+	float q[SAMPLES][4];
+};
+static LOG log_data;
+
+// 3軸をゆっくり振り回しながら, ジャイロのゼロ点のずれとノイズを加える
+static void make_log() {
+	MOTION motion;
+	motion.gyro_noise = 3;
+	motion.accel_noise = 40;
+	motion.gyro_bias[0] = 0.005f;
+	motion.gyro_bias[1] = -0.003f;
+	const float dt = 1.0f / SAMPLE_RATE;
+	for (int k = 0; k < SAMPLES; k++) {
+		float t = k * dt;
+		motion.w[0] = 0.8f * sinf(2 * (float)M_PI * 0.5f * t);
+		motion.w[1] = 0.6f * sinf(2 * (float)M_PI * 0.3f * t + 1);
+		motion.w[2] = 0.5f * sinf(2 * (float)M_PI * 0.2f * t);
+		motion.advance(dt);
+		motion.sense(log_data.g[k], log_data.a[k], log_data.m[k]);
+		for (int i = 0; i < 4; i++) log_data.q[k][i] = motion.q[i];
+	}
+}
+
+static double now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+template <class ENGINE>
+static void setup(IMU_FILTER_T<ENGINE> &filter) {
+	filter.set_sample_rate(SAMPLE_RATE);
+	filter.set_gres(MOTION_GRES);
+}
+
+template <class ENGINE>
+static bool run(const char *name) {
+	// 精度
+	IMU_FILTER_T<ENGINE> filter;
+	setup(filter);
+	double se = 0;
+	float err_max = 0;
+	int n = 0;
+	for (int k = 0; k < SAMPLES; k++) {
+		const float *g = log_data.g[k], *a = log_data.a[k], *m = log_data.m[k];
+		filter.update(g[0], g[1], g[2], a[0], a[1], a[2], m[0], m[1], m[2]);
+		if (k >= SETTLE * SAMPLE_RATE) {
+			float q[4];
+			filter.get_quaternion(q);
+			float e = motion_angle(q, log_data.q[k]);
+			se += e * e;
+			err_max = fmaxf(err_max, e);
+			n++;
+		}
+	}
+	float rms = sqrt(se / n);
+	// 時間
+	volatile float sink = 0;
+	double t0 = now_ns();
+	for (int r = 0; r < REPEAT; r++) {
+		IMU_FILTER_T<ENGINE> f;
+		setup(f);
+		for (int k = 0; k < SAMPLES; k++) {
+			const float *g = log_data.g[k], *a = log_data.a[k], *m = log_data.m[k];
+			f.update(g[0], g[1], g[2], a[0], a[1], a[2], m[0], m[1], m[2]);
+		}
+		float q[4];
+		f.get_quaternion(q);
+		sink += q[0];
+	}
+	double ns = (now_ns() - t0) / ((double)REPEAT * SAMPLES);
+	bool ok = rms < ACCURACY_MAX;
+	printf("%-9s ram %3u (filter %3u) bytes  time %6.1f ns/update  error rms %.4f max %.4f rad  %s\n",
+		name, (unsigned)sizeof(ENGINE), (unsigned)sizeof(IMU_FILTER_T<ENGINE>), ns, rms, err_max, ok ? "ok" : "FAIL");
+	return ok;
+}
+
+int main() {
+	make_log();
+	bool ok = true;
+	ok &= run<MADGWICK>("madgwick");
+	ok &= run<MAHONY>("mahony");
+	ok &= run<ESKF>("eskf");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+// タイムスタンプで積算する更新(IMU_FILTER_T::update_micros)の再生テスト
+//   jitter: 傾いた軸回りに3.1rad/sで回しながら, サンプルの間隔を±1ms揺らし,
+//           時々3msの途切れを入れる. 10秒後の姿勢の誤差を
+//           一定の経過時間(update)とタイムスタンプ(update_micros)で比べる
+//   gap:    長く途切れた後にreset_time()で再開すると経過時間の異常に数えない
+#include <stdio.h>
+#include "imu_filter.h"
+#include "driver_motion.h"
+
+#define SAMPLE_RATE   600
+#define PERIOD        1667   // (us)
+#define JITTER        1000   // (us)
+#define GAP           3000   // 97サンプルごとの途切れ(us)
+#define SAMPLES       6000
+#define MEASURED_MAX  1e-3f  // タイムスタンプで積算したときの誤差の上限(rad)
+
+static float run(bool measured, unsigned long &anomaly) {
+	IMU_FILTER filter;
+	filter.set_sample_rate(SAMPLE_RATE);
+	filter.set_gres(MOTION_GRES);
+	MOTION motion;
+	motion.w[0] = 0.8f, motion.w[1] = -0.5f, motion.w[2] = 3.0f;
+	MOTION_NOISE noise(3);
+	unsigned long t = 0;
+	float g[3], a[3], m[3];
+	motion.sense(g, a, m);
+	filter.update_micros(0, 0, 0, 0, 0, 0, 0, 0, 0, t);
+	for (int k = 0; k < SAMPLES; k++) {
+		unsigned long step = PERIOD + (unsigned long)(noise.uniform() * (2 * JITTER)) - JITTER;
+		if (0 == k % 97) {
+			step += GAP;
+		}
+		t += step;
+		motion.advance(step * 1e-6f);
+		if (measured) {
+			filter.update_micros(g[0], g[1], g[2], 0, 0, 0, 0, 0, 0, t);
+		} else {
+			filter.update(g[0], g[1], g[2], 0, 0, 0, 0, 0, 0);
+		}
+	}
+	anomaly = filter.get_dt_anomaly();
+	float q[4];
+	filter.get_quaternion(q);
+	return motion_angle(q, motion.q);
+}
+
+int main() {
+	int fail = 0;
+	unsigned long anomaly_fixed, anomaly_measured;
+	float fixed = run(false, anomaly_fixed);
+	float measured = run(true, anomaly_measured);
+	bool ok = measured < MEASURED_MAX && measured < fixed;
+	printf("jitter  fixed %.5f rad  measured %.2e rad  anomalies %lu  %s\n",
+		fixed, measured, anomaly_measured, ok ? "ok" : "FAIL");
+	if (!ok) fail = 1;
+
+	// 100ms途切れた後に再開する
+	IMU_FILTER filter;
+	filter.set_sample_rate(SAMPLE_RATE);
+	filter.update_micros(0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	filter.update_micros(0, 0, 0, 0, 0, 0, 0, 0, 0, 100000);
+	unsigned long clamped = filter.get_dt_anomaly();
+	filter.reset_time();
+	filter.update_micros(0, 0, 0, 0, 0, 0, 0, 0, 0, 200000);
+	ok = 1 == clamped && 1 == filter.get_dt_anomaly() && fabsf(filter.get_dt() - 1.0f / SAMPLE_RATE) < 1e-6f;
+	printf("gap     without reset %lu anomaly, after reset_time dt %.6f s  %s\n",
+		clamped, filter.get_dt(), ok ? "ok" : "FAIL");
+	if (!ok) fail = 1;
+	return fail;
+}
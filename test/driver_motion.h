@@ -0,0 +1,101 @@
+#ifndef __DRIVER_MOTION_H__
+#define __DRIVER_MOTION_H__
+
+// 姿勢推定のテスト用の合成データ
+// 真の姿勢を細かい刻みで積算し, そのときのセンサーの生の値(LSB)を作る
+// 姿勢の向きはIMU_FILTERと同じ(q' = -q⊗ω/2, 加速度と方位は回転行列の転置で機体座標にする)
+
+#include <math.h>
+#include <stdint.h>
+#include "fusion.h"
+
+// 分解能(lsm9ds1_config.hの設定: 245dps, 2g)
+#define MOTION_GRES   (8.75e-3f * 3.14159265f / 180) // (rad/s)/LSB
+#define MOTION_ARES   (0.061e-3f)                    // g/LSB
+#define MOTION_MAG    3000.0f                        // 地磁気の大きさ(LSB)
+// 真の姿勢の積算の分割数
+#define MOTION_SUBSTEPS 16
+
+// 正規乱数(再現できるように独自の線形合同法)
+struct MOTION_NOISE {
+	uint32_t state;
+
+	explicit MOTION_NOISE(uint32_t seed = 1) : state(seed) { }
+	float uniform() {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+	float gauss() {
+		float s = 0;
+		for (int i = 0; i < 12; i++) {
+			s += uniform();
+		}
+		return s - 6;
+	}
+};
+
+struct MOTION {
+	float q[4];          // 真の姿勢
+	float w[3];          // 真の角速度(rad/s)
+	float gyro_bias[3];  // ジャイロのゼロ点のずれ(rad/s)
+	float gyro_noise;    // ジャイロのノイズ(LSB)
+	float accel_noise;   // 加速度のノイズ(LSB)
+	float accel_ext[3];  // 運動加速度(g, 機体座標)
+	MOTION_NOISE noise;
+
+	MOTION() {
+		q[0] = 1, q[1] = 0, q[2] = 0, q[3] = 0;
+		for (int i = 0; i < 3; i++) {
+			w[i] = 0;
+			gyro_bias[i] = 0;
+			accel_ext[i] = 0;
+		}
+		gyro_noise = 0;
+		accel_noise = 0;
+	}
+	// 傾けた姿勢から始める(axisは単位ベクトル)
+	void set_attitude(float angle, const float axis[3]) {
+		float s = sinf(0.5f * angle);
+		q[0] = cosf(0.5f * angle);
+		q[1] = s * axis[0], q[2] = s * axis[1], q[3] = s * axis[2];
+	}
+	// 真の姿勢を角速度wでdt秒進める
+	void advance(float dt) {
+		float h = dt / MOTION_SUBSTEPS;
+		for (int n = 0; n < MOTION_SUBSTEPS; n++) {
+			// 中点法
+			float dq[4], m[4];
+			quat_derivative(q, w[0], w[1], w[2], dq);
+			for (int i = 0; i < 4; i++) m[i] = q[i] + 0.5f * h * dq[i];
+			quat_derivative(m, w[0], w[1], w[2], dq);
+			for (int i = 0; i < 4; i++) q[i] += h * dq[i];
+		}
+		float r = 1.0f / sqrtf(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+		for (int i = 0; i < 4; i++) q[i] *= r;
+	}
+	// 現在のセンサーの生の値
+	void sense(float g[3], float a[3], float m[3]) {
+		const float qw = q[0], qx = q[1], qy = q[2], qz = q[3];
+		// 鉛直(Z軸基準ベクトル)と地磁気(北向きで下に傾く)を機体座標にする
+		float zx = 2*(qx*qz - qw*qy), zy = 2*(qy*qz + qw*qx), zz = 2*(qw*qw + qz*qz) - 1;
+		float xx = 2*(qw*qw + qx*qx) - 1, xy = 2*(qx*qy - qw*qz), xz = 2*(qx*qz + qw*qy);
+		const float hn = 0.45f, hd = 0.89f;
+		for (int i = 0; i < 3; i++) {
+			g[i] = (w[i] + gyro_bias[i]) / MOTION_GRES + gyro_noise * noise.gauss();
+		}
+		a[0] = (zx + accel_ext[0]) / MOTION_ARES + accel_noise * noise.gauss();
+		a[1] = (zy + accel_ext[1]) / MOTION_ARES + accel_noise * noise.gauss();
+		a[2] = (zz + accel_ext[2]) / MOTION_ARES + accel_noise * noise.gauss();
+		m[0] = (hn*xx + hd*zx) * MOTION_MAG;
+		m[1] = (hn*xy + hd*zy) * MOTION_MAG;
+		m[2] = (hn*xz + hd*zz) * MOTION_MAG;
+	}
+};
+
+// 2つの姿勢の間の回転角(rad)
+inline float motion_angle(const float a[4], const float b[4]) {
+	float d = fabsf(a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3]);
+	return 2 * acosf(d > 1 ? 1 : d);
+}
+
+#endif /* __DRIVER_MOTION_H__ */
@@ -0,0 +1,56 @@
+// ジャイロのフィルタ(GYRO_PREFILTER)の段を途中で有効にするテスト
+//   zero:   0の状態から始めると, ジャイロのバイアス(直流)で出力が跳ぶ
+//   lpf:    動いている途中で低域通過を有効にしても跳ばない
+//   notch:  動いている途中でノッチを有効にしても跳ばない
+//   q:      周波数だけ動かしてもコマンドで設定したQは残る(track_notchesと同じ呼び方)
+#include <stdio.h>
+#include <math.h>
+#include "prefilter.h"
+
+#define SAMPLE_RATE  600
+#define BIAS         0.3f   // ジャイロのバイアス(rad/s)
+#define SAMPLES      300
+#define STEP_MAX     1e-4f  // 有効にした後の出力の跳びの上限(rad/s)
+
+static int fail = 0;
+
+// 入力を直流のまま通したときの出力と入力の差の最大
+static float run(GYRO_PREFILTER &filter) {
+	float worst = 0;
+	for (int k = 0; k < SAMPLES; k++) {
+		float x = BIAS, y = -BIAS, z = 2 * BIAS;
+		filter.update(x, y, z);
+		worst = fmaxf(worst, fmaxf(fabsf(x - BIAS), fmaxf(fabsf(y + BIAS), fabsf(z - 2 * BIAS))));
+	}
+	return worst;
+}
+
+static void check(const char *name, float step, bool ok) {
+	printf("%-6s step %.2e rad/s  %s\n", name, step, ok ? "ok" : "FAIL");
+	if (!ok) fail = 1;
+}
+
+int main() {
+	GYRO_PREFILTER filter;
+	filter.set_sample_rate(SAMPLE_RATE);
+	filter.set_notch(0, 100);
+	float step = run(filter);
+	check("zero", step, step > 100 * STEP_MAX);
+
+	filter.set_notch(0, 0);
+	filter.reset();
+	run(filter);
+	filter.set_lowpass(80);
+	step = run(filter);
+	check("lpf", step, step < STEP_MAX);
+
+	filter.set_notch(1, 150, 5);
+	step = run(filter);
+	check("notch", step, step < STEP_MAX);
+
+	filter.set_notch(1, 170, filter.get_notch_q(1));
+	bool ok = 5 == filter.get_notch_q(1) && 170 == filter.get_notch(1);
+	printf("q      notch %.0f Hz q %.1f  %s\n", filter.get_notch(1), filter.get_notch_q(1), ok ? "ok" : "FAIL");
+	if (!ok) fail = 1;
+	return fail;
+}
@@ -0,0 +1,70 @@
+// IMU_READER(imu_reader.cpp)の読込みの遅れをシミュレーションしたセンサーで確かめる
+// 転送ごとに遅延があり, 新しいデータが出るまでの時間を変えても(SIM_LSM9DS1::hold)
+//   timeout: IMU_READER_TIMEOUTで待てば毎回ジャイロを受け取れる(ホストの遅れの分だけ許す)
+//   period:  1周期(DELTA_TIME)しか待たないと, 遅れた読込みで受け取れない周期がある
+#include <stdio.h>
+#include "Arduino.h"
+#include "Wire.h"
+#include "lsm9ds1.h"
+#include "imu_reader.h"
+#include "sim_lsm9ds1.h"
+
+// main.cppの周期(us)
+#define DELTA_TIME   (1000000 / 600)
+// I2C 400kHzで6バイトを読む時間くらいの遅延(us)
+#define LATENCY      150
+#define READS        200
+// ホスト(1コアのこともある)のスケジューリングで遅れて失敗してよい回数
+#define HOST_FAILS   (READS / 50)
+
+static int fail = 0;
+
+// holdを0からIMU_READER_POLL_TIMEの手前まで変えて読み込み, 受け取れなかった回数を返す
+static int run(IMU_READER &reader, SIM_LSM9DS1 &sim, unsigned long timeout, unsigned long &longest) {
+	int failed = 0;
+	longest = 0;
+	for (int i = 0; i < READS; i++) {
+		sim.hold((unsigned long)i * 97 % (IMU_READER_POLL_TIME - 100));
+		unsigned long begin = micros();
+		reader.start();
+		IMU_SAMPLE s;
+		if (!reader.collect(s, timeout) || !s.valid_g) {
+			failed++;
+			// 続いている読込みを受け取ってから次へ
+			reader.collect(s, IMU_READER_TIMEOUT);
+		}
+		if (micros() - begin > longest) {
+			longest = micros() - begin;
+		}
+	}
+	return failed;
+}
+
+int main() {
+	SIM_LSM9DS1 sim;
+	Wire.attach(&sim);
+	stub_pin = &sim;
+	Wire.begin(SDA, SCL, 400000);
+	LSM9DS1 imu;
+	if (0 == imu.begin(sim.addr_ag, sim.addr_m)) {
+		printf("begin   no answer  FAIL\n");
+		return 1;
+	}
+	sim.latency = LATENCY;
+	IMU_READER reader;
+	reader.begin(imu, 0);
+
+	unsigned long longest;
+	int failed = run(reader, sim, IMU_READER_TIMEOUT, longest);
+	bool ok = failed <= HOST_FAILS;
+	printf("timeout %d of %d reads failed, longest %lu us (timeout %d us)  %s\n",
+		failed, READS, longest, IMU_READER_TIMEOUT, ok ? "ok" : "FAIL");
+	if (!ok) fail = 1;
+
+	// 遅れた読込みを見捨てていた以前の待ち方
+	failed = run(reader, sim, DELTA_TIME, longest);
+	ok = failed > 10 * HOST_FAILS;
+	printf("period  %d of %d reads failed with %d us  %s\n", failed, READS, DELTA_TIME, ok ? "ok" : "FAIL");
+	if (!ok) fail = 1;
+	return fail;
+}
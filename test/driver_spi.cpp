@@ -0,0 +1,65 @@
+// SPIでつないだLSM9DS1の設定と回復(lsm9ds1.cpp)をシミュレーションしたセンサーで確かめる
+//   begin:  両方のダイのI2Cを止める(CTRL_REG9とCTRL_REG3_MのI2C_DISABLE)
+//   check:  応答していれば何もしない
+//   reset:  電源の瞬断で設定が消えたらcheck()で見つけ, I2C_DISABLEも含めて書き戻す
+//   lost:   応答が無ければ失敗を数え, 戻れば読める
+// lsm9ds1.hはWire.hとSPI.hが無くてもコンパイルできること(だから最初にインクルードする)
+#include "lsm9ds1.h"
+#include <stdio.h>
+#include "Arduino.h"
+#include "SPI.h"
+#include "sim_lsm9ds1.h"
+
+static int fail = 0;
+
+static void check(const char *name, bool ok, const char *format, ...) {
+	char detail[160];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(detail, sizeof(detail), format, args);
+	va_end(args);
+	printf("%-7s %s  %s\n", name, detail, ok ? "ok" : "FAIL");
+	if (!ok) fail = 1;
+}
+
+// I2C_DISABLE(CTRL_REG9のbit2, CTRL_REG3_Mのbit7)
+static bool i2c_disabled(SIM_LSM9DS1 &sim) {
+	return 0 != (sim.get_ag(0x23) & (1<<2)) && 0 != (sim.get_m(0x22) & (1<<7));
+}
+
+int main() {
+	SIM_LSM9DS1 sim;
+	SPI.attach(&sim);
+	stub_pin = &sim;
+	LSM9DS1 imu;
+	uint16_t who = imu.begin_spi(sim.cs_ag, sim.cs_m);
+	uint8_t ctrl_reg1_g = sim.get_ag(0x10);
+	check("begin", 0x683D == who && 0 != ctrl_reg1_g && i2c_disabled(sim),
+		"who_am_i %04x ctrl_reg1_g %02x i2c %s", who, ctrl_reg1_g, i2c_disabled(sim) ? "disabled" : "enabled");
+
+	uint32_t recovers = imu.recover_count;
+	bool ok = imu.check();
+	check("check", ok && imu.recover_count == recovers, "check %s recovers +%u",
+		ok ? "true" : "false", (unsigned)(imu.recover_count - recovers));
+
+	// 電源の瞬断(レジスタは既定値に戻り, WHO_AM_Iは変わらない)
+	sim.power_on();
+	uint32_t errors = imu.error_count;
+	ok = imu.check();
+	check("reset", ok && imu.recover_count == recovers + 1 && imu.error_count == errors + 1
+		&& sim.get_ag(0x10) == ctrl_reg1_g && i2c_disabled(sim),
+		"check %s recovers +%u ctrl_reg1_g %02x i2c %s", ok ? "true" : "false",
+		(unsigned)(imu.recover_count - recovers), sim.get_ag(0x10), i2c_disabled(sim) ? "disabled" : "enabled");
+
+	// 外れたセンサー(MISOは0xFFのまま)
+	SPI.attach(nullptr);
+	errors = imu.error_count;
+	ok = imu.check();
+	check("lost", !ok && imu.error_count == errors + 1, "check %s errors +%u",
+		ok ? "true" : "false", (unsigned)(imu.error_count - errors));
+	SPI.attach(&sim);
+	sim.gyro[0] = 1234;
+	ok = imu.check() && imu.read_g() && 1234 == imu.gx;
+	check("resume", ok, "gx %d", imu.gx);
+	return fail;
+}
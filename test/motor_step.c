@@ -0,0 +1,66 @@
+/* step24(8bit 24ステップ)とstep96(10bit 96ステップ)の比較
+ * テーブルの大きさ, 1回のデューティ計算の時間(ホスト), 同じ位相での出力の差を表示し
+ * 出力の差が8bitで2LSB(step24のテーブルの量子化の分)を超えたら失敗にする */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "step24.h"
+#include "step96.h"
+
+static double
+now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int
+main() {
+    int fail = 0;
+    int step;
+    int diff_max = 0;
+    for (step = 0; step <= STEP24_STEP_MAX; step++) {
+        step24_set_duty(STEP24_AMP_MAX, step);
+        step96_set_duty(STEP96_AMP_MAX, step << 2);
+        int d[3] = {
+            (step96_duty_u >> 2) - (unsigned char)step24_duty_u,
+            (step96_duty_v >> 2) - (unsigned char)step24_duty_v,
+            (step96_duty_w >> 2) - (unsigned char)step24_duty_w,
+        };
+        int i;
+        for (i = 0; i < 3; i++) {
+            int a = abs(d[i]);
+            if (a > diff_max) {
+                diff_max = a;
+            }
+        }
+    }
+    printf("table   step24 %u bytes (VALUE %u + INDEX %u), step96 %u bytes\n",
+        (unsigned)(sizeof(STEP24_VALUE) + sizeof(STEP24_INDEX)),
+        (unsigned)sizeof(STEP24_VALUE), (unsigned)sizeof(STEP24_INDEX),
+        (unsigned)sizeof(STEP96_VALUE));
+    printf("steps   step24 %d, step96 %d per cycle\n", STEP24_STEP_MAX + 1, STEP96_STEP_MAX + 1);
+    printf("diff    max %d LSB (8bit) at full amplitude\n", diff_max);
+    if (diff_max > 2) {
+        printf("FAIL: step96 differs from step24 by more than 2 LSB\n");
+        fail = 1;
+    }
+
+    const int n = 1 << 22;
+    volatile unsigned sink = 0;
+    int i;
+    double t0 = now_ns();
+    for (i = 0; i < n; i++) {
+        step24_set_duty((i & 63) > STEP24_AMP_MAX ? STEP24_AMP_MAX : (i & 63), i % (STEP24_STEP_MAX + 1));
+        sink += step24_duty_u + step24_duty_v + step24_duty_w;
+    }
+    double t1 = now_ns();
+    for (i = 0; i < n; i++) {
+        step96_set_duty(i & 255, i % (STEP96_STEP_MAX + 1));
+        sink += step96_duty_u + step96_duty_v + step96_duty_w;
+    }
+    double t2 = now_ns();
+    printf("cost    step24 %.2f ns, step96 %.2f ns per step (host, 3 phases)\n",
+        (t1 - t0) / n, (t2 - t1) / n);
+    return fail;
+}
@@ -0,0 +1,85 @@
+/* 速度推定(velocity.h)の分解能の比較
+ * 一定の回転数で相変化を起こし, TMR1周期ごとに
+ *   count:  従来のTMR1周期内の相変化数(step24_velocity << VELOCITY_SHIFT)
+ *   hybrid: velocity_value(低速は相変化の間隔, 高速は相変化数)
+ * を真値(TMR1周期あたりの相変化数 << VELOCITY_SHIFT)と比べ, 誤差の二乗平均を表示する
+ * 低速で hybrid の誤差が count より小さく, 高速で悪化しないことを確かめる */
+#include <stdio.h>
+#include <math.h>
+
+volatile unsigned char GIE;
+volatile unsigned char TMR1H;
+#include "step24.h"
+#include "velocity.h"
+
+#define SUBTICKS     256 /* TMR1L単位 */
+#define WINDOW       (VELOCITY_WINDOW_TICKS * SUBTICKS)
+#define LOOP_PERIOD  128 /* メインループの周期(TMR1L単位, 32us) */
+#define SETTLE       64  /* 平滑化が落ち着くまでのTMR1周期の数 */
+#define WINDOWS      512
+
+/* rate: TMR1周期あたりの相変化数 */
+static void
+run(double rate, double *rms_count, double *rms_hybrid) {
+    double period = WINDOW / rate; /* 相変化の間隔(TMR1L単位) */
+    double next = period * 0.37;
+    double truth = rate * (1 << VELOCITY_SHIFT);
+    double e_count = 0, e_hybrid = 0;
+    unsigned long t;
+    int window = 0;
+    velocity_time_base = 0;
+    velocity_phase_time = 0;
+    velocity_period = 0xFFFF;
+    velocity_value = 0;
+    velocity_window = 0;
+    step24_phase_sum = 0;
+    step24_velocity = 0;
+    for (t = 0; window < SETTLE + WINDOWS; t += LOOP_PERIOD) {
+        if (t && 0 == t % WINDOW) {
+            /* TMR1の割込み */
+            STEP24_SET_VELOCITY;
+            VELOCITY_SET_WINDOW;
+            window++;
+        }
+        TMR1H = 128 + (t % WINDOW) / SUBTICKS;
+        char diff = 0;
+        while (next <= t) {
+            diff++;
+            next += period;
+        }
+        step24_phase_sum += diff;
+        velocity_update(diff);
+        if (0 == (t + LOOP_PERIOD) % WINDOW && window >= SETTLE) {
+            double c = (double)(step24_velocity << VELOCITY_SHIFT) - truth;
+            double h = (double)velocity_value - truth;
+            e_count += c * c;
+            e_hybrid += h * h;
+        }
+    }
+    *rms_count = sqrt(e_count / WINDOWS) / truth;
+    *rms_hybrid = sqrt(e_hybrid / WINDOWS) / truth;
+}
+
+int
+main() {
+    static const double RATES[] = { 0.3, 0.6, 1.1, 1.7, 2.5, 3.3, 4.5, 8.2, 16.7, 33.3, 66.7 };
+    int fail = 0;
+    unsigned i;
+    printf("changes/window  electrical Hz  count rms  hybrid rms\n");
+    for (i = 0; i < sizeof(RATES) / sizeof(RATES[0]); i++) {
+        double c, h;
+        run(RATES[i], &c, &h);
+        /* 電気角1周期あたり24相変化, TMR1周期8.192ms */
+        double hz = RATES[i] / 0.008192 / 24;
+        printf("%14.1f  %13.1f  %8.1f%%  %9.1f%%\n", RATES[i], hz, c * 100, h * 100);
+        if (RATES[i] < VELOCITY_PERIOD_COUNT && h >= c) {
+            printf("FAIL: hybrid is not finer than count at %.1f changes/window\n", RATES[i]);
+            fail = 1;
+        }
+        if (RATES[i] >= VELOCITY_PERIOD_COUNT && h > c + 0.01) {
+            printf("FAIL: hybrid is worse than count at %.1f changes/window\n", RATES[i]);
+            fail = 1;
+        }
+    }
+    return fail;
+}
@@ -0,0 +1,311 @@
+#include "sim_lsm9ds1.h"
+
+// レジスタ(lsm9ds1.cppと同じ番号)
+#define OUT_TEMP_L    0x15
+#define STATUS_REG_0  0x17
+#define OUT_X_L_G     0x18
+#define CTRL_REG1_G   0x10
+#define CTRL_REG8     0x22
+#define CTRL_REG9     0x23
+#define STATUS_REG_1  0x27
+#define OUT_X_L_XL    0x28
+#define WHO_AM_I      0x0F
+#define CTRL_REG1_M   0x20
+#define CTRL_REG3_M   0x22
+#define STATUS_REG_M  0x27
+#define OUT_X_L_M     0x28
+
+// ジャイロ(ODR_G), 方位(DO)の出力レート(mHz)
+static const unsigned long ODR_G[8] = { 0, 14900, 59500, 119000, 238000, 476000, 952000, 0 };
+static const unsigned long ODR_M[8] = { 625, 1250, 2500, 5000, 10000, 20000, 40000, 80000 };
+
+SIM_LSM9DS1::SIM_LSM9DS1(uint8_t addr_ag, uint8_t addr_m, uint8_t cs_ag, uint8_t cs_m) :
+	addr_ag(addr_ag), addr_m(addr_m), cs_ag(cs_ag), cs_m(cs_m), sda(SDA), scl(SCL) {
+	for (int i = 0; i < 3; i++) {
+		gyro[i] = 0;
+		accel[i] = 0;
+		mag[i] = 0;
+	}
+	temp = 25;
+	latency = 0;
+	transfers = 0;
+	nacks = 0;
+	gyro_reads = 0;
+	hold_until = 0;
+	nack_count = 0;
+	nack_writes = false;
+	stuck = false;
+	stuck_clocks = 0;
+	port_running = false;
+	pin_sda = HIGH;
+	pin_scl = HIGH;
+	selected = 0;
+	spi_pos = 0;
+	spi_read = false;
+	spi_addr = 0;
+	spi_inc = false;
+	power_on();
+}
+
+void SIM_LSM9DS1::power_on() {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	memset(reg_ag, 0, sizeof(reg_ag));
+	memset(reg_m, 0, sizeof(reg_m));
+	reg_ag[WHO_AM_I] = 0x68;
+	reg_ag[CTRL_REG8] = 0x04;
+	reg_m[WHO_AM_I] = 0x3D;
+	reg_m[CTRL_REG3_M] = 0x03;
+	pointer = 0;
+	pointer_inc = false;
+	read_g = read_a = read_m = -1;
+}
+
+void SIM_LSM9DS1::fail(int count, bool writes) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	nack_count = count;
+	nack_writes = writes;
+}
+
+void SIM_LSM9DS1::stick(int clocks) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	stuck = true;
+	stuck_clocks = clocks;
+}
+
+bool SIM_LSM9DS1::is_stuck() {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	return stuck;
+}
+
+void SIM_LSM9DS1::hold(unsigned long us) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	hold_until = micros() + us;
+}
+
+uint8_t SIM_LSM9DS1::get_ag(uint8_t addr) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	return reg_ag[addr & 0x7F];
+}
+
+uint8_t SIM_LSM9DS1::get_m(uint8_t addr) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	return reg_m[addr & 0x3F];
+}
+
+bool SIM_LSM9DS1::transfer_fails(bool write) {
+	transfers++;
+	if (latency != 0) {
+		delayMicroseconds(latency);
+	}
+	if (stuck) {
+		nacks++;
+		return true;
+	}
+	if (nack_count > 0 && (write || !nack_writes)) {
+		nack_count--;
+		nacks++;
+		return true;
+	}
+	return false;
+}
+
+long SIM_LSM9DS1::sample_g() {
+	unsigned long odr = ODR_G[reg_ag[CTRL_REG1_G] >> 5];
+	unsigned long now = micros();
+	if (0 == odr || (long)(now - hold_until) < 0) {
+		return -1;
+	}
+	return (long)((unsigned long long)now * odr / 1000000000ull);
+}
+
+long SIM_LSM9DS1::sample_m() {
+	if (0 != (reg_m[CTRL_REG3_M] & 0x03)) {
+		return -1;
+	}
+	unsigned long now = micros();
+	if ((long)(now - hold_until) < 0) {
+		return -1;
+	}
+	unsigned long odr = ODR_M[(reg_m[CTRL_REG1_M] >> 2) & 0x07];
+	return (long)((unsigned long long)now * odr / 1000000000ull);
+}
+
+uint8_t SIM_LSM9DS1::read_reg(bool ag, uint8_t addr) {
+	if (!ag) {
+		addr &= 0x3F;
+		if (STATUS_REG_M == addr) {
+			long s = sample_m();
+			return (s >= 0 && s > read_m) ? 0x0F : 0;
+		}
+		if (addr >= OUT_X_L_M && addr < OUT_X_L_M + 6) {
+			if (OUT_X_L_M == addr) {
+				read_m = sample_m();
+			}
+			int16_t v = mag[(addr - OUT_X_L_M) >> 1];
+			return (addr - OUT_X_L_M) & 1 ? (uint8_t)(v >> 8) : (uint8_t)v;
+		}
+		return reg_m[addr];
+	}
+	addr &= 0x7F;
+	if (STATUS_REG_0 == addr || STATUS_REG_1 == addr) {
+		long s = sample_g();
+		uint8_t status = 0;
+		if (s >= 0 && s > read_a) status |= 1<<0;
+		if (s >= 0 && s > read_g) status |= 1<<1;
+		if (s >= 0) status |= 1<<2;
+		return status;
+	}
+	if (addr >= OUT_X_L_G && addr < OUT_X_L_G + 6) {
+		if (OUT_X_L_G == addr) {
+			read_g = sample_g();
+			gyro_reads++;
+		}
+		int16_t v = gyro[(addr - OUT_X_L_G) >> 1];
+		return (addr - OUT_X_L_G) & 1 ? (uint8_t)(v >> 8) : (uint8_t)v;
+	}
+	if (addr >= OUT_X_L_XL && addr < OUT_X_L_XL + 6) {
+		if (OUT_X_L_XL == addr) {
+			read_a = sample_g();
+		}
+		int16_t v = accel[(addr - OUT_X_L_XL) >> 1];
+		return (addr - OUT_X_L_XL) & 1 ? (uint8_t)(v >> 8) : (uint8_t)v;
+	}
+	if (OUT_TEMP_L == addr || OUT_TEMP_L + 1 == addr) {
+		int16_t v = (int16_t)((temp - 25) * 256);
+		return OUT_TEMP_L == addr ? (uint8_t)v : (uint8_t)(v >> 8);
+	}
+	return reg_ag[addr];
+}
+
+void SIM_LSM9DS1::write_reg(bool ag, uint8_t addr, uint8_t value) {
+	if (ag) {
+		reg_ag[addr & 0x7F] = value;
+	} else {
+		reg_m[addr & 0x3F] = value;
+	}
+}
+
+bool SIM_LSM9DS1::i2c_write(uint8_t address, const uint8_t *data, size_t len) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	bool ag = address == addr_ag;
+	if (!ag && address != addr_m) {
+		return false;
+	}
+	// SPIにしてI2Cを止めたダイは応答しない
+	if ((ag && (reg_ag[CTRL_REG9] & (1<<2))) || (!ag && (reg_m[CTRL_REG3_M] & (1<<7)))) {
+		return false;
+	}
+	// レジスタへの書込み(サブアドレスの後にデータがある)
+	if (transfer_fails(len > 1)) {
+		return false;
+	}
+	if (len == 0) {
+		return true;
+	}
+	// 方位はサブアドレスの最上位ビット, 加速度とジャイロはIF_ADD_INCで連続にする
+	pointer = data[0];
+	pointer_inc = ag ? 0 != (reg_ag[CTRL_REG8] & 0x04) : 0 != (data[0] & 0x80);
+	pointer &= 0x7F;
+	for (size_t i = 1; i < len; i++) {
+		write_reg(ag, pointer, data[i]);
+		if (pointer_inc) {
+			pointer++;
+		}
+	}
+	return true;
+}
+
+bool SIM_LSM9DS1::i2c_read(uint8_t address, uint8_t *data, size_t len) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	bool ag = address == addr_ag;
+	if (!ag && address != addr_m) {
+		return false;
+	}
+	if (transfer_fails(false)) {
+		return false;
+	}
+	for (size_t i = 0; i < len; i++) {
+		data[i] = read_reg(ag, pointer);
+		if (pointer_inc) {
+			pointer++;
+		}
+	}
+	return true;
+}
+
+void SIM_LSM9DS1::i2c_end() {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	port_running = false;
+}
+
+void SIM_LSM9DS1::i2c_begin() {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	port_running = true;
+}
+
+uint8_t SIM_LSM9DS1::spi_transfer(uint8_t data) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	if (0 == selected) {
+		return 0xFF;
+	}
+	bool ag = 1 == selected;
+	if (0 == spi_pos++) {
+		// 1バイト目: [R/W][(方位のみ)M/S][アドレス]
+		spi_read = 0 != (data & 0x80);
+		spi_inc = ag ? 0 != (reg_ag[CTRL_REG8] & 0x04) : 0 != (data & 0x40);
+		spi_addr = ag ? data & 0x7F : data & 0x3F;
+		if (latency != 0) {
+			delayMicroseconds(latency);
+		}
+		return 0xFF;
+	}
+	uint8_t ret = 0xFF;
+	if (spi_read) {
+		ret = read_reg(ag, spi_addr);
+	} else {
+		write_reg(ag, spi_addr, data);
+	}
+	if (spi_inc) {
+		spi_addr++;
+	}
+	return ret;
+}
+
+void SIM_LSM9DS1::pin_write(uint8_t pin, uint8_t value) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	if (pin == cs_ag || pin == cs_m) {
+		selected = LOW == value ? (pin == cs_ag ? 1 : 2) : 0;
+		spi_pos = 0;
+		return;
+	}
+	if (port_running) {
+		return;
+	}
+	if (pin == scl) {
+		// SDAを掴んでいる間はSCLの立下りで1ビット進む
+		if (stuck && HIGH == pin_scl && LOW == value && stuck_clocks > 0) {
+			stuck_clocks--;
+		}
+		pin_scl = value;
+	} else if (pin == sda) {
+		// SCLがHIGHの間のSDAの立上りはSTOP
+		if (stuck && 0 == stuck_clocks && HIGH == pin_scl && LOW == pin_sda && HIGH == value) {
+			stuck = false;
+		}
+		pin_sda = value;
+	}
+}
+
+int SIM_LSM9DS1::pin_read(uint8_t pin) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	if (pin == sda) {
+		if (stuck && stuck_clocks > 0) {
+			return LOW;
+		}
+		return pin_sda;
+	}
+	if (pin == scl) {
+		return pin_scl;
+	}
+	return HIGH;
+}
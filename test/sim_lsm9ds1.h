@@ -0,0 +1,89 @@
+#ifndef __SIM_LSM9DS1_H__
+#define __SIM_LSM9DS1_H__
+
+// LSM9DS1のシミュレーション(I2CとSPIのスレーブ)
+// レジスタ, 出力レートに合わせたデータの更新(STATUS_REGのフラグ),
+// 転送ごとの遅延, 転送の失敗(NACK)とSDAを掴んだままのバスを再現する
+
+#include <mutex>
+#include "Arduino.h"
+#include "Wire.h"
+#include "SPI.h"
+
+class SIM_LSM9DS1 : public I2C_SLAVE, public SPI_SLAVE, public STUB_PIN {
+public:
+	// I2Cのアドレス, SPIのチップセレクト, I2Cのピン
+	uint8_t addr_ag, addr_m;
+	uint8_t cs_ag, cs_m;
+	uint8_t sda, scl;
+	// 出力する値
+	int16_t gyro[3], accel[3], mag[3], temp;
+	// 1転送あたりの遅延(us)
+	unsigned long latency;
+	// 統計
+	unsigned long transfers;   // I2Cの転送(書込みと読込み)の回数
+	unsigned long nacks;       // 失敗させた転送の回数
+	unsigned long gyro_reads;  // ジャイロの出力を読まれた回数
+
+private:
+	std::recursive_mutex mutex;
+	uint8_t reg_ag[128];
+	uint8_t reg_m[64];
+	// I2Cのレジスタのポインタ(最後に書き込んだサブアドレス)
+	uint8_t pointer;
+	bool pointer_inc;
+	// 出力を読まれたサンプルの番号
+	long read_g, read_a, read_m;
+	// この時刻(us)までは新しいデータを出さない
+	unsigned long hold_until;
+	// 失敗させる残りの転送の数(nack_writesなら書込みだけ)
+	int nack_count;
+	bool nack_writes;
+	// SDAを掴んでいる(SCLのクロック数で放し, STOPで戻る)
+	bool stuck;
+	int stuck_clocks;
+	// I2Cのポートが動いている間はピンの操作は届かない
+	bool port_running;
+	uint8_t pin_sda, pin_scl;
+	// SPIで選ばれているダイ(0: なし, 1: ag, 2: m)と転送のバイト位置
+	int selected;
+	int spi_pos;
+	bool spi_read;
+	uint8_t spi_addr;
+	bool spi_inc;
+
+public:
+	SIM_LSM9DS1(uint8_t addr_ag = 0x6B, uint8_t addr_m = 0x1E, uint8_t cs_ag = 15, uint8_t cs_m = 16);
+	// 電源を入れ直した状態(レジスタは既定値)にする
+	void power_on();
+	// 次のcount回の転送(writesなら書込みだけ)を失敗させる
+	void fail(int count, bool writes = false);
+	// SDAを掴んだままにする(SCLをclocksクロックで放す)
+	void stick(int clocks);
+	bool is_stuck();
+	// us(us)の間新しいデータを出さない
+	void hold(unsigned long us);
+	uint8_t get_ag(uint8_t addr);
+	uint8_t get_m(uint8_t addr);
+
+	// I2C_SLAVE
+	bool i2c_write(uint8_t address, const uint8_t *data, size_t len) override;
+	bool i2c_read(uint8_t address, uint8_t *data, size_t len) override;
+	void i2c_end() override;
+	void i2c_begin() override;
+	// SPI_SLAVE
+	uint8_t spi_transfer(uint8_t data) override;
+	// STUB_PIN
+	void pin_write(uint8_t pin, uint8_t value) override;
+	int pin_read(uint8_t pin) override;
+
+private:
+	bool transfer_fails(bool write);
+	// 出力レートのサンプル番号(-1なら停止中)
+	long sample_g();
+	long sample_m();
+	uint8_t read_reg(bool ag, uint8_t addr);
+	void write_reg(bool ag, uint8_t addr, uint8_t value);
+};
+
+#endif /* __SIM_LSM9DS1_H__ */
@@ -0,0 +1,84 @@
+#ifndef __STUB_ARDUINO_H__
+#define __STUB_ARDUINO_H__
+
+// ホストでdriverのソースを動かすためのArduino(ESP32)とFreeRTOSの代わり
+// 時刻はホストの時計, タスクはスレッド, タスク通知は条件変数で動かす
+// ピンの操作はstub_pinに渡す(センサーのシミュレーションがI2CとSPIのピンを見る)
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+typedef uint8_t byte;
+
+#define OUTPUT            0x03
+#define INPUT             0x01
+#define INPUT_PULLUP      0x05
+#define OUTPUT_OPEN_DRAIN 0x13
+#define HIGH 1
+#define LOW  0
+
+static const uint8_t SDA = 21;
+static const uint8_t SCL = 22;
+static const uint8_t SS = 5;
+static const uint8_t MOSI = 23;
+static const uint8_t MISO = 19;
+static const uint8_t SCK = 18;
+
+unsigned long micros();
+unsigned long millis();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+// ピンの操作を受け取る側(nullptrなら書込みは捨てて読込みはHIGH)
+struct STUB_PIN {
+	virtual void pin_write(uint8_t pin, uint8_t value) = 0;
+	virtual int pin_read(uint8_t pin) = 0;
+};
+extern STUB_PIN *stub_pin;
+
+inline float atoff(const char *s) {
+	return (float)atof(s);
+}
+
+class EspClass {
+public:
+	// ホストの時計から240MHzのサイクル数を作る
+	uint32_t getCycleCount();
+	uint32_t getCpuFreqMHz() {
+		return 240;
+	}
+	void restart() {
+		abort();
+	}
+};
+extern EspClass ESP;
+
+// FreeRTOS(1tick = 1ms)
+typedef struct STUB_TASK *TaskHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+#define pdPASS            1
+#define pdFAIL            0
+#define pdTRUE            1
+#define pdFALSE           0
+#define portMAX_DELAY     0xffffffffu
+#define portTICK_PERIOD_MS 1
+#define configMAX_PRIORITIES 25
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms) / portTICK_PERIOD_MS)
+
+BaseType_t xTaskCreatePinnedToCore(void (*entry)(void*), const char *name, uint32_t stack, void *arg, UBaseType_t priority, TaskHandle_t *task, BaseType_t core);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+void xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+void vTaskDelay(TickType_t ticks);
+
+#endif /* __STUB_ARDUINO_H__ */
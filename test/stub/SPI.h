@@ -0,0 +1,48 @@
+#ifndef __STUB_SPI_H__
+#define __STUB_SPI_H__
+
+// SPI(チップセレクトはdigitalWriteでスレーブに伝わる)
+
+#include "Arduino.h"
+
+#define MSBFIRST  1
+#define SPI_MODE0 0
+#define SPI_MODE3 3
+
+// SPIのスレーブ(チップセレクトはSTUB_PINで受け取る)
+struct SPI_SLAVE {
+	virtual uint8_t spi_transfer(uint8_t data) = 0;
+};
+
+class SPISettings {
+public:
+	SPISettings(uint32_t clock = 1000000, uint8_t order = MSBFIRST, uint8_t mode = SPI_MODE0) { }
+};
+
+class SPIClass {
+private:
+	SPI_SLAVE *slave;
+
+public:
+	SPIClass() : slave(nullptr) { }
+	void attach(SPI_SLAVE *slave) {
+		this->slave = slave;
+	}
+	void begin() { }
+	void beginTransaction(SPISettings settings) { }
+	void endTransaction() { }
+	uint8_t transfer(uint8_t data) {
+		return slave != nullptr ? slave->spi_transfer(data) : 0xFF;
+	}
+	void transferBytes(const uint8_t *tx, uint8_t *rx, uint32_t len) {
+		for (uint32_t i = 0; i < len; i++) {
+			uint8_t d = transfer(tx != nullptr ? tx[i] : 0xFF);
+			if (rx != nullptr) {
+				rx[i] = d;
+			}
+		}
+	}
+};
+extern SPIClass SPI;
+
+#endif /* __STUB_SPI_H__ */
@@ -0,0 +1,62 @@
+#ifndef __STUB_WIRE_H__
+#define __STUB_WIRE_H__
+
+// I2C(arduino-esp32のTwoWireと同じ振る舞い)
+// 転送はattachしたスレーブに渡す. 動いているポートのbegin()は何もしない
+
+#include "Arduino.h"
+
+// I2Cのスレーブ(falseを返すとNACK)
+struct I2C_SLAVE {
+	virtual bool i2c_write(uint8_t address, const uint8_t *data, size_t len) = 0;
+	virtual bool i2c_read(uint8_t address, uint8_t *data, size_t len) = 0;
+	// ポートが止められた, 開始された
+	virtual void i2c_end() { }
+	virtual void i2c_begin() { }
+};
+
+#define STUB_WIRE_BUFFER 32
+
+class TwoWire {
+private:
+	I2C_SLAVE *slave;
+	bool running;
+	uint32_t clock;
+	uint8_t address;
+	uint8_t tx[STUB_WIRE_BUFFER];
+	size_t tx_len;
+	uint8_t rx[STUB_WIRE_BUFFER];
+	size_t rx_len;
+	size_t rx_pos;
+
+public:
+	TwoWire() : slave(nullptr), running(false), clock(100000), address(0), tx_len(0), rx_len(0), rx_pos(0) { }
+	void attach(I2C_SLAVE *slave) {
+		this->slave = slave;
+	}
+	bool is_running() const {
+		return running;
+	}
+	bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0);
+	bool end();
+	void setClock(uint32_t frequency) {
+		clock = frequency;
+	}
+	uint32_t getClock() {
+		return clock;
+	}
+	void beginTransmission(uint8_t address);
+	size_t write(uint8_t data);
+	// 0: 成功, 2: アドレスでNACK, 4: その他(ポートが止まっている)
+	uint8_t endTransmission(bool stop = true);
+	uint8_t requestFrom(uint8_t address, uint8_t len);
+	int available() {
+		return (int)(rx_len - rx_pos);
+	}
+	int read() {
+		return rx_pos < rx_len ? rx[rx_pos++] : -1;
+	}
+};
+extern TwoWire Wire;
+
+#endif /* __STUB_WIRE_H__ */
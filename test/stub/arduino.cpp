@@ -0,0 +1,104 @@
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Arduino.h"
+
+static const auto start_time = std::chrono::steady_clock::now();
+
+static uint64_t elapsed_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+unsigned long micros() {
+	return (unsigned long)(elapsed_ns() / 1000);
+}
+unsigned long millis() {
+	return (unsigned long)(elapsed_ns() / 1000000);
+}
+void delay(unsigned long ms) {
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+void delayMicroseconds(unsigned int us) {
+	// ESP32と同じく空回りで待つ
+	unsigned long begin = micros();
+	while (micros() - begin < us) {
+	}
+}
+
+STUB_PIN *stub_pin = nullptr;
+
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+void digitalWrite(uint8_t pin, uint8_t value) {
+	if (stub_pin != nullptr) {
+		stub_pin->pin_write(pin, value);
+	}
+}
+int digitalRead(uint8_t pin) {
+	return stub_pin != nullptr ? stub_pin->pin_read(pin) : HIGH;
+}
+
+EspClass ESP;
+
+uint32_t EspClass::getCycleCount() {
+	return (uint32_t)(elapsed_ns() * 240 / 1000);
+}
+
+// タスクと通知の値
+struct STUB_TASK {
+	std::mutex mutex;
+	std::condition_variable cv;
+	uint32_t notify = 0;
+};
+
+static thread_local STUB_TASK *current_task = nullptr;
+
+// FreeRTOSと同じくticks後のtick割込みの時刻(待つ時間は(ticks - 1)から(ticks)ms)
+static std::chrono::steady_clock::time_point tick_deadline(TickType_t ticks) {
+	return start_time + std::chrono::milliseconds((millis() / portTICK_PERIOD_MS + ticks) * portTICK_PERIOD_MS);
+}
+
+BaseType_t xTaskCreatePinnedToCore(void (*entry)(void*), const char *name, uint32_t stack, void *arg, UBaseType_t priority, TaskHandle_t *task, BaseType_t core) {
+	// タスクは終わらないので解放しない
+	STUB_TASK *t = new STUB_TASK;
+	if (task != nullptr) {
+		*task = t;
+	}
+	std::thread([t, entry, arg]() {
+		current_task = t;
+		entry(arg);
+	}).detach();
+	return pdPASS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+	if (current_task == nullptr) {
+		current_task = new STUB_TASK;
+	}
+	return current_task;
+}
+
+void xTaskNotifyGive(TaskHandle_t task) {
+	std::lock_guard<std::mutex> lock(task->mutex);
+	task->notify++;
+	task->cv.notify_one();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+	STUB_TASK *t = xTaskGetCurrentTaskHandle();
+	std::unique_lock<std::mutex> lock(t->mutex);
+	auto ready = [t]() { return t->notify != 0; };
+	if (ticks == portMAX_DELAY) {
+		t->cv.wait(lock, ready);
+	} else if (!t->cv.wait_until(lock, tick_deadline(ticks), ready)) {
+		return 0;
+	}
+	uint32_t value = t->notify;
+	t->notify = clear ? 0 : value - 1;
+	return value;
+}
+
+void vTaskDelay(TickType_t ticks) {
+	std::this_thread::sleep_until(tick_deadline(ticks));
+}
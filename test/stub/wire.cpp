@@ -0,0 +1,64 @@
+#include "Wire.h"
+#include "SPI.h"
+
+TwoWire Wire;
+SPIClass SPI;
+
+bool TwoWire::begin(int sda, int scl, uint32_t frequency) {
+	// arduino-esp32と同じく, 動いているポートは設定も状態もそのまま
+	if (running) {
+		return true;
+	}
+	if (frequency != 0) {
+		clock = frequency;
+	}
+	running = true;
+	if (slave != nullptr) {
+		slave->i2c_begin();
+	}
+	return true;
+}
+
+bool TwoWire::end() {
+	running = false;
+	if (slave != nullptr) {
+		slave->i2c_end();
+	}
+	return true;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+	this->address = address;
+	tx_len = 0;
+}
+
+size_t TwoWire::write(uint8_t data) {
+	if (tx_len >= STUB_WIRE_BUFFER) {
+		return 0;
+	}
+	tx[tx_len++] = data;
+	return 1;
+}
+
+uint8_t TwoWire::endTransmission(bool stop) {
+	if (!running) {
+		return 4;
+	}
+	if (slave == nullptr || !slave->i2c_write(address, tx, tx_len)) {
+		return 2;
+	}
+	return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t len) {
+	rx_len = 0;
+	rx_pos = 0;
+	if (!running || len > STUB_WIRE_BUFFER) {
+		return 0;
+	}
+	if (slave == nullptr || !slave->i2c_read(address, rx, len)) {
+		return 0;
+	}
+	rx_len = len;
+	return len;
+}